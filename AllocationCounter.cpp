@@ -0,0 +1,78 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace
+{
+    std::atomic<size_t> allocationCount{ 0 };
+}
+
+#ifdef COUNT_ALLOCATIONS
+void* operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+#endif
+
+bool AllocationCounter::isEnabled()
+{
+#ifdef COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t AllocationCounter::getAllocationCount()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+void FrameAllocationCheck::beginFrame()
+{
+    frameStartCount = AllocationCounter::getAllocationCount();
+}
+
+size_t FrameAllocationCheck::endFrame()
+{
+    size_t allocations = AllocationCounter::getAllocationCount() - frameStartCount;
+    if (frame++ < warmupFrames) return allocations;
+
+    if (allocations > 0) {
+        steadyStateAllocations += allocations;
+        std::cerr << "ERROR::FRAME_ALLOCATIONS:: Frame " << frame - 1 << " made " << allocations << " heap allocations." << std::endl;
+    }
+    assert(allocations == 0 && "steady-state frames must not allocate");
+    return allocations;
+}
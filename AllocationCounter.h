@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts heap allocations made through operator new.
+// Counting is compiled in only when COUNT_ALLOCATIONS is defined (Debug builds), otherwise the count stays at zero.
+namespace AllocationCounter
+{
+    bool isEnabled();
+    size_t getAllocationCount();
+}
+
+// Test hook for the steady-state frame: wrap each frame in beginFrame/endFrame.
+// Once the warm-up frames have passed, any heap allocation inside a frame is reported and fails an assert.
+class FrameAllocationCheck
+{
+public:
+    FrameAllocationCheck(int warmupFrames = 60) : warmupFrames(warmupFrames)
+    {
+
+    }
+
+    void beginFrame();
+    size_t endFrame();  // Returns the allocations made during the frame
+
+    size_t getSteadyStateAllocations() const {
+        return steadyStateAllocations;
+    }
+
+private:
+    int warmupFrames;
+    int frame = 0;
+    size_t frameStartCount = 0;
+    size_t steadyStateAllocations = 0;  // Allocations in frames after the warm-up
+};
@@ -0,0 +1,67 @@
+#include "AnimatedBounds.h"
+
+#include "AnimationInstance.h"
+
+namespace
+{
+    // Union of the bone boxes under one palette, plus the vertices no bone moves
+    BoundingBox boundPose(const Model& model, const std::vector<glm::mat4>& palette)
+    {
+        BoundingBox bounds = model.getUnskinnedBounds();
+        const std::vector<BoundingBox>& boneBounds = model.getBoneBounds();
+        for (size_t bone = 0; bone < boneBounds.size(); bone++) {
+            bounds.expand(boneBounds[bone].transformed(palette[bone]));
+        }
+        return bounds;
+    }
+
+    // Furthest any bone box corner moves between two palettes
+    float largestCornerStep(const Model& model, const std::vector<glm::mat4>& from, const std::vector<glm::mat4>& to)
+    {
+        float step = 0.0f;
+        const std::vector<BoundingBox>& boneBounds = model.getBoneBounds();
+        for (size_t bone = 0; bone < boneBounds.size(); bone++) {
+            if (!boneBounds[bone].isValid()) continue;
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec4 point(boneBounds[bone].getCorner(corner), 1.0f);
+                step = std::max(step, glm::length(glm::vec3(to[bone] * point) - glm::vec3(from[bone] * point)));
+            }
+        }
+        return step;
+    }
+}
+
+ClipBounds computeClipBounds(const Model& model, const Animation& animation, const AnimatedBoundsSettings& settings)
+{
+    ClipBounds bounds;
+    int segmentCount = std::max(settings.segmentsPerClip, 1);
+    int samplesPerSegment = std::max(settings.samplesPerSegment, 1);
+    if (!model.hasSkeleton() || animation.duration <= 0.0f) return bounds;
+
+    AnimationInstance instance(&model, true);  // Runs while the model loads
+    std::vector<glm::mat4> palette(model.getBoneCount(), glm::mat4(1.0f));
+    std::vector<glm::mat4> lastPalette = palette;
+    bounds.segmentDuration = animation.duration / segmentCount;
+    bounds.segments.resize(segmentCount);
+
+    for (int segment = 0; segment < segmentCount; segment++) {
+        BoundingBox& box = bounds.segments[segment];
+        float padding = 0.0f;
+        for (int sample = 0; sample <= samplesPerSegment; sample++) {
+            // getPose wraps a time of exactly duration back to 0, so the end of the clip is taken just short of it
+            float time = bounds.segmentDuration * (segment + static_cast<float>(sample) / samplesPerSegment);
+            time = std::min(time, std::nextafter(animation.duration, 0.0f));
+            std::fill(palette.begin(), palette.end(), glm::mat4(1.0f));
+            instance.getPose(animation, time, palette, glm::mat4(1.0f));
+
+            box.expand(boundPose(model, palette));
+            if (sample > 0) {
+                padding = std::max(padding, largestCornerStep(model, lastPalette, palette));
+            }
+            lastPalette.swap(palette);
+        }
+        box.pad(padding);
+        bounds.clip.expand(box);
+    }
+    return bounds;
+}
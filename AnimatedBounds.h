@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Axis-aligned box. Starts empty, min above max, until a point is added.
+struct BoundingBox
+{
+    glm::vec3 min = glm::vec3(1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    bool isValid() const
+    {
+        return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+    }
+
+    void expand(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const BoundingBox& other)
+    {
+        if (!other.isValid()) return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    void pad(float distance)
+    {
+        min -= glm::vec3(distance);
+        max += glm::vec3(distance);
+    }
+
+    glm::vec3 getCorner(int index) const
+    {
+        return glm::vec3(index & 1 ? max.x : min.x, index & 2 ? max.y : min.y, index & 4 ? max.z : min.z);
+    }
+
+    // Box around this box under an affine transform, from the centre and the absolute matrix applied to the half extent
+    BoundingBox transformed(const glm::mat4& transform) const
+    {
+        if (!isValid()) return *this;
+        glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+        glm::vec3 halfExtent = (max - min) * 0.5f;
+        glm::vec3 extent(0.0f);
+        for (int column = 0; column < 3; column++) {
+            for (int row = 0; row < 3; row++) {
+                extent[row] += std::fabs(transform[column][row]) * halfExtent[column];
+            }
+        }
+        BoundingBox result;
+        result.min = center - extent;
+        result.max = center + extent;
+        return result;
+    }
+
+    float getVolume() const
+    {
+        if (!isValid()) return 0.0f;
+        glm::vec3 size = max - min;
+        return size.x * size.y * size.z;
+    }
+};
+
+// Conservative model-space bounds of a skinned model over one clip, one box per equal slice of the clip.
+// Looking up the box for a clip time is a single divide, so objects can be culled every frame.
+struct ClipBounds
+{
+    float segmentDuration = 0.0f;
+    std::vector<BoundingBox> segments = {};
+    BoundingBox clip;  // Union of every segment
+
+    bool isValid() const
+    {
+        return !segments.empty();
+    }
+
+    const BoundingBox& getBounds(float time) const
+    {
+        int segment = segmentDuration > 0.0f ? static_cast<int>(time / segmentDuration) : 0;
+        return segments[std::min(std::max(segment, 0), static_cast<int>(segments.size()) - 1)];
+    }
+};
+
+struct AnimatedBoundsSettings
+{
+    int segmentsPerClip = 16;
+    int samplesPerSegment = 4;  // Poses sampled per segment, plus the one at its end
+};
+
+class Model;
+struct Animation;
+
+// Samples the clip with the normal pose path and bounds every sample by the bind-space box of each bone's
+// vertices moved by that bone's palette matrix. A linear blend skinned vertex is a weighted average of its
+// bones' transforms of it, so it stays inside the union of those boxes. Each segment is padded by the furthest
+// any box corner moves between two samples, to cover the poses in between.
+ClipBounds computeClipBounds(const Model& model, const Animation& animation, const AnimatedBoundsSettings& settings);
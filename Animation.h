@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Skeleton.h"
+#include "KeyframeCursor.h"
+#include "CompressedAnimation.h"
+#include "PoseKernel.h"
+#include "AnimatedBounds.h"
+
+struct BoneTransformTrack {
+    std::vector<float> positionTimestamps = {};
+    std::vector<float> rotationTimestamps = {};
+    std::vector<float> scaleTimestamps = {};
+
+    std::vector<glm::vec3> positions = {};
+    std::vector<glm::quat> rotations = {};
+    std::vector<glm::vec3> scales = {};
+
+    size_t sizeInBytes() const {
+        return (positionTimestamps.size() + rotationTimestamps.size() + scaleTimestamps.size()) * sizeof(float)
+            + positions.size() * sizeof(glm::vec3) + rotations.size() * sizeof(glm::quat) + scales.size() * sizeof(glm::vec3);
+    }
+};
+
+const int NO_CHANNEL = -1;
+
+// Index of a clip in its Model, resolved once at load so playback never looks clips up by name
+typedef int ClipHandle;
+const ClipHandle NO_CLIP = -1;
+
+struct Animation {
+    float duration = 0.0f;
+    float ticksPerSecond = 1.0f;
+    std::vector<BoneTransformTrack> channels = {};
+    std::vector<int> jointChannels = {};  // Channel index per skeleton joint, NO_CHANNEL if the joint is not animated
+    std::unordered_map<std::string, int> channelsByName = {};  // Load-time and debug view only, never used while sampling
+    CompressedClip compressed = {};  // Packed copy of channels, sampled instead of them once valid
+    ClipBounds bounds = {};          // Model-space bounds of the skinned meshes over the clip, see computeClipBounds
+
+    const BoneTransformTrack* getJointChannel(int joint) const {
+        int channel = jointChannels[joint];
+        return channel != NO_CHANNEL ? &channels[channel] : nullptr;
+    }
+
+    const BoneTransformTrack* findChannel(const std::string& name) const {
+        auto it = channelsByName.find(name);
+        return it != channelsByName.end() ? &channels[it->second] : nullptr;
+    }
+};
+
+// Samples the keyframes of one channel, resuming each track's keyframe search from the given cursors.
+// Tracks with a single key hold that key for the whole animation.
+inline JointPose sampleChannel(const BoneTransformTrack& btt, float time, ChannelCursors& cursors) {
+    JointPose pose;
+
+    // Interpolate position
+    std::pair<unsigned int, float> fp = findKeyframe(btt.positionTimestamps, time, cursors.position);
+    pose.position = fp.first == 0 ? btt.positions[0] : glm::mix(btt.positions[fp.first - 1], btt.positions[fp.first], fp.second);
+
+    // Interpolate rotation
+    fp = findKeyframe(btt.rotationTimestamps, time, cursors.rotation);
+    pose.rotation = fp.first == 0 ? btt.rotations[0] : glm::slerp(btt.rotations[fp.first - 1], btt.rotations[fp.first], fp.second);
+
+    // Interpolate scale
+    fp = findKeyframe(btt.scaleTimestamps, time, cursors.scale);
+    pose.scale = fp.first == 0 ? btt.scales[0] : glm::mix(btt.scales[fp.first - 1], btt.scales[fp.first], fp.second);
+
+    return pose;
+}
+
+// Gathers the key pair around time for each track of one channel into a lane of the batch.
+// The pose kernel then interpolates and composes all lanes together.
+inline void gatherChannel(const BoneTransformTrack& btt, float time, ChannelCursors& cursors, PoseSamplingBatch& batch, int lane) {
+    std::pair<unsigned int, float> fp = findKeyframe(btt.positionTimestamps, time, cursors.position);
+    unsigned int from = fp.first == 0 ? 0 : fp.first - 1;
+    batch.setPositionKeys(lane, btt.positions[from], btt.positions[fp.first], fp.second);
+
+    fp = findKeyframe(btt.rotationTimestamps, time, cursors.rotation);
+    from = fp.first == 0 ? 0 : fp.first - 1;
+    batch.setRotationKeys(lane, btt.rotations[from], btt.rotations[fp.first], fp.second);
+
+    fp = findKeyframe(btt.scaleTimestamps, time, cursors.scale);
+    from = fp.first == 0 ? 0 : fp.first - 1;
+    batch.setScaleKeys(lane, btt.scales[from], btt.scales[fp.first], fp.second);
+}
+
+// Samples one channel from the packed stream when the animation has been compressed, from its keyframes otherwise
+inline JointPose sampleJoint(const Animation& animation, int channel, float time, ChannelCursors& cursors) {
+    if (animation.compressed.isValid()) {
+        return animation.compressed.sampleChannel(channel, time);
+    }
+    return sampleChannel(animation.channels[channel], time, cursors);
+}
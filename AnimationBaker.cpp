@@ -0,0 +1,143 @@
+#include "AnimationBaker.h"
+
+#include <cmath>
+#include <iostream>
+#include "AnimationInstance.h"
+
+BakedAnimationTexture::~BakedAnimationTexture()
+{
+    release();
+}
+
+bool BakedAnimationTexture::bake(const Model& model, float sampleRate)
+{
+    clips.clear();
+    texels.clear();
+    rowCount = 0;
+    if (!model.isReady()) {
+        std::cout << "ERROR::ANIMATION_BAKER:: Model is still loading." << std::endl;
+        return false;
+    }
+    boneCount = model.getBoneCount();
+    this->sampleRate = sampleRate;
+
+    if (!model.hasSkeleton() || boneCount == 0) {
+        std::cout << "ERROR::ANIMATION_BAKER:: Model has no skeleton to bake." << std::endl;
+        return false;
+    }
+
+    for (const auto& pair : model.getAnimations()) {
+        if (static_cast<int>(clips.size()) == MAX_BAKED_CLIPS) {
+            std::cout << "WARNING::ANIMATION_BAKER:: Only the first " << MAX_BAKED_CLIPS << " clips are baked." << std::endl;
+            break;
+        }
+        BakedClip clip;
+        clip.name = pair.first;
+        clip.firstFrame = rowCount;
+        clip.duration = pair.second.duration;
+        clip.frameCount = static_cast<int>(std::ceil(clip.duration * sampleRate)) + 1;
+        clips.push_back(clip);
+        rowCount += clip.frameCount;
+    }
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (maxTextureSize > 0 && (boneCount * BAKED_TEXELS_PER_BONE > maxTextureSize || rowCount > maxTextureSize)) {
+        std::cout << "ERROR::ANIMATION_BAKER:: " << boneCount * BAKED_TEXELS_PER_BONE << " x " << rowCount
+            << " texels exceed the texture size limit of " << maxTextureSize << "." << std::endl;
+        clips.clear();
+        rowCount = 0;
+        return false;
+    }
+
+    // The same pose path as live playback, one palette per frame
+    AnimationInstance instance(&model);
+    std::vector<glm::mat4> palette(boneCount, glm::mat4(1.0f));
+    size_t rowFloats = static_cast<size_t>(boneCount) * BAKED_TEXELS_PER_BONE * 4;
+    texels.resize(rowFloats * rowCount);
+
+    for (const BakedClip& clip : clips) {
+        const Animation& animation = model.getAnimations().at(clip.name);
+        for (int frame = 0; frame < clip.frameCount; frame++) {
+            // Frames evenly spread over the clip, at least sampleRate apart. getPose wraps a time of exactly
+            // duration back to 0, so the last frame is taken just short of it
+            float time = clip.frameCount > 1 ? clip.duration * frame / (clip.frameCount - 1) : 0.0f;
+            time = std::min(time, std::nextafter(clip.duration, 0.0f));
+            std::fill(palette.begin(), palette.end(), glm::mat4(1.0f));
+            instance.getPose(animation, time, palette, glm::mat4(1.0f));
+
+            float* row = texels.data() + rowFloats * (clip.firstFrame + frame);
+            for (int bone = 0; bone < boneCount; bone++) {
+                const glm::mat4& m = palette[bone];
+                for (int r = 0; r < BAKED_TEXELS_PER_BONE; r++) {
+                    float* texel = row + (bone * BAKED_TEXELS_PER_BONE + r) * 4;
+                    texel[0] = m[0][r];
+                    texel[1] = m[1][r];
+                    texel[2] = m[2][r];
+                    texel[3] = m[3][r];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool BakedAnimationTexture::upload()
+{
+    if (texels.empty()) return false;
+
+    if (!texture) glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, boneCount * BAKED_TEXELS_PER_BONE, rowCount, 0, GL_RGBA, GL_FLOAT, texels.data());
+    // Read with texelFetch only, frames are interpolated in the shader
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    OpenGLErrors::checkOpenGLError("BakedAnimationTexture::upload");
+    return true;
+}
+
+void BakedAnimationTexture::release()
+{
+    if (texture) glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
+void BakedAnimationTexture::bind(GLuint program, int textureUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "bakedPalettes"), textureUnit);
+
+    // firstFrame, frameCount, duration per clip
+    glm::vec4 table[MAX_BAKED_CLIPS];
+    for (size_t i = 0; i < clips.size(); i++) {
+        table[i] = glm::vec4(static_cast<float>(clips[i].firstFrame), static_cast<float>(clips[i].frameCount), clips[i].duration, 0.0f);
+    }
+    if (!clips.empty()) {
+        glUniform4fv(glGetUniformLocation(program, "bakedClips[0]"), static_cast<GLsizei>(clips.size()), &table[0][0]);
+    }
+}
+
+int BakedAnimationTexture::findClip(const std::string& name) const
+{
+    for (size_t i = 0; i < clips.size(); i++) {
+        if (clips[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+glm::mat4 BakedAnimationTexture::getBoneTransform(int row, int boneID) const
+{
+    const float* texel = texels.data() + (static_cast<size_t>(row) * boneCount + boneID) * BAKED_TEXELS_PER_BONE * 4;
+    glm::mat4 m(1.0f);
+    for (int r = 0; r < BAKED_TEXELS_PER_BONE; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[c][r] = texel[r * 4 + c];
+        }
+    }
+    return m;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "Model.h"
+
+const int MAX_BAKED_CLIPS = 32;  // BakedCrowdVertex.vs declares the same, change both together
+const int BAKED_TEXELS_PER_BONE = 3;  // The top three rows of the bone matrix, the fourth is always 0 0 0 1
+
+// Where one clip lives in the baked texture. Frames are spread evenly from time 0 to duration.
+struct BakedClip
+{
+    std::string name;
+    int firstFrame = 0;    // Texture row of frame 0
+    int frameCount = 0;
+    float duration = 0.0f;
+};
+
+// Every clip of a model evaluated offline into bone palettes, stored in one RGBA32F texture for crowd rendering.
+// One row per baked frame, BAKED_TEXELS_PER_BONE texels per bone ID along the row. The shader finds the row
+// from (clip, time) using the clip table bound next to the texture, so drawing a crowd needs no CPU pose evaluation.
+class BakedAnimationTexture
+{
+public:
+    BakedAnimationTexture() = default;
+    BakedAnimationTexture(const BakedAnimationTexture&) = delete;
+    BakedAnimationTexture& operator=(const BakedAnimationTexture&) = delete;
+    ~BakedAnimationTexture();
+
+    // Runs getPose over every clip at no less than sampleRate frames per animation time unit.
+    // Needs a context only to check the texture size limit, upload creates the texture.
+    bool bake(const Model& model, float sampleRate = 30.0f);
+    bool upload();
+    void release();
+
+    // Binds the texture to the unit and sets the clip table uniforms of the program, which must be in use
+    void bind(GLuint program, int textureUnit) const;
+
+    // Clip index for CrowdInstance::clip, -1 if the model had no clip of that name. Load-time lookup.
+    int findClip(const std::string& name) const;
+
+    // Baked palette entry, as read back from the CPU copy
+    glm::mat4 getBoneTransform(int row, int boneID) const;
+
+    const std::vector<BakedClip>& getClips() const {
+        return clips;
+    }
+
+    int getBoneCount() const {
+        return boneCount;
+    }
+
+    int getRowCount() const {
+        return rowCount;
+    }
+
+    float getSampleRate() const {
+        return sampleRate;
+    }
+
+    size_t getSizeInBytes() const {
+        return texels.size() * sizeof(float);
+    }
+
+    GLuint getTexture() const {
+        return texture;
+    }
+
+private:
+    std::vector<BakedClip> clips;
+    std::vector<float> texels;  // Kept after upload for validation and re-uploads
+    int boneCount = 0;
+    int rowCount = 0;
+    float sampleRate = 30.0f;
+    GLuint texture = 0;
+};
@@ -0,0 +1,756 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Model.h"
+#include "AnimationInstance.h"
+#include "JobSystem.h"
+#include "GameObjectManager.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include "DualQuaternion.h"
+#include "SkinningKernel.h"
+
+// Headless microbenchmarks for the animation runtime.
+// None of these touch OpenGL, so they can be run before the window is created.
+namespace AnimationBenchmarks
+{
+    // Runs fn the given number of times and returns the average cost of one call in microseconds
+    template <typename Fn>
+    inline double measureMicroseconds(int iterations, Fn&& fn)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            fn(i);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+    }
+
+    // Tree form of the skeleton, laid out the way getPose walked it before the skeleton was flattened
+    struct RecursiveBone
+    {
+        int joint = Skeleton::NO_JOINT;
+        std::vector<RecursiveBone> children = {};
+    };
+
+    inline RecursiveBone buildBoneTree(const Skeleton& skeleton, int joint)
+    {
+        RecursiveBone bone;
+        bone.joint = joint;
+        for (int i = joint + 1; i < skeleton.size(); i++) {
+            if (skeleton.parents[i] == joint) {
+                bone.children.push_back(buildBoneTree(skeleton, i));
+            }
+        }
+        return bone;
+    }
+
+    // Reference pose evaluation: recursive, pointer chasing, parent matrices passed down the stack,
+    // channels looked up by bone name for every bone
+    inline void getPoseRecursive(const Model& model, const Animation& animation, const RecursiveBone& bone, float dt,
+        std::vector<glm::mat4>& output, const glm::mat4& parentTransform, const glm::mat4& globalInverseTransform)
+    {
+        const Skeleton& skeleton = model.getSkeleton();
+        const BoneTransformTrack* channel = animation.findChannel(skeleton.names[bone.joint]);
+        if (!channel) {
+            for (const RecursiveBone& child : bone.children) {
+                getPoseRecursive(model, animation, child, dt, output, parentTransform, globalInverseTransform);
+            }
+            return;
+        }
+
+        dt = fmod(dt, animation.duration);
+        ChannelCursors cursors;
+        glm::mat4 globalTransform = parentTransform * sampleChannel(*channel, dt, cursors).toMatrix();
+        output[skeleton.boneIDs[bone.joint]] = globalInverseTransform * globalTransform * skeleton.offsets[bone.joint];
+
+        for (const RecursiveBone& child : bone.children) {
+            getPoseRecursive(model, animation, child, dt, output, globalTransform, globalInverseTransform);
+        }
+    }
+
+    // Compares the flattened forward-loop getPose against the recursive tree walk for every clip of the model
+    inline void runPoseBenchmark(const Model& model, int iterations = 10000)
+    {
+        const Skeleton& skeleton = model.getSkeleton();
+        if (skeleton.empty()) {
+            cout << "BENCHMARK::POSE:: Model has no skeleton." << endl;
+            return;
+        }
+
+        AnimationInstance instance(&model);
+        std::vector<glm::mat4> output(model.getBoneCount(), glm::mat4(1.0f));
+        RecursiveBone root = buildBoneTree(skeleton, 0);
+        const glm::mat4 identity = glm::mat4(1.0f);
+
+        for (const auto& pair : model.getAnimations()) {
+            const Animation& animation = pair.second;
+            float step = animation.duration / iterations;
+
+            double recursiveUs = measureMicroseconds(iterations, [&](int i) {
+                getPoseRecursive(model, animation, root, i * step, output, identity, identity);
+            });
+            double flatUs = measureMicroseconds(iterations, [&](int i) {
+                instance.getPose(animation, i * step, output, identity);
+            });
+
+            cout << "BENCHMARK::POSE:: " << pair.first << " joints: " << skeleton.size()
+                << " recursive: " << recursiveUs << " us"
+                << " flat: " << flatUs << " us"
+                << " speedup: " << recursiveUs / flatUs << "x" << endl;
+        }
+    }
+
+    // The keyframe search getTimeFraction used before cursors: a linear scan from the first key on every call
+    inline std::pair<unsigned int, float> findKeyframeLinear(const std::vector<float>& times, float time)
+    {
+        unsigned int frame = 1;
+        while (frame < times.size() && time >= times[frame]) {
+            frame++;
+        }
+        frame = std::min(frame, static_cast<unsigned int>(times.size() - 1));
+
+        float lastTime = times[frame - 1];
+        float nextTime = times[frame];
+        return { frame, (time - lastTime) / (nextTime - lastTime) };
+    }
+
+    // Plays a synthetic track of increasing length at a quarter key per frame and reports the cost of one lookup.
+    // With cursors the cost should stay flat as the key count grows, the linear scan grows with it.
+    inline void runKeyframeSamplingBenchmark()
+    {
+        const unsigned int keyCounts[] = { 16, 64, 256, 1024, 4096, 16384 };
+        const float stepPerFrame = 0.25f;
+
+        for (unsigned int keyCount : keyCounts) {
+            std::vector<float> times(keyCount);
+            for (unsigned int i = 0; i < keyCount; i++) {
+                times[i] = static_cast<float>(i);
+            }
+
+            int samples = static_cast<int>((keyCount - 1) / stepPerFrame);
+            float checksum = 0.0f;  // Keeps the lookups from being optimized away
+
+            double linearUs = measureMicroseconds(samples, [&](int i) {
+                checksum += findKeyframeLinear(times, i * stepPerFrame).second;
+            });
+
+            KeyframeCursor cursor;
+            double cursorUs = measureMicroseconds(samples, [&](int i) {
+                checksum += findKeyframe(times, i * stepPerFrame, cursor).second;
+            });
+
+            double binaryUs = measureMicroseconds(samples, [&](int i) {
+                KeyframeCursor fresh;  // A cold cursor always takes the binary search path
+                fresh.frame = 0;
+                checksum += findKeyframe(times, i * stepPerFrame, fresh).second;
+            });
+
+            cout << "BENCHMARK::KEYFRAMES:: keys: " << keyCount
+                << " linear: " << linearUs * 1000.0 << " ns"
+                << " cursor: " << cursorUs * 1000.0 << " ns"
+                << " binary: " << binaryUs * 1000.0 << " ns"
+                << " (checksum " << checksum << ")" << endl;
+        }
+    }
+
+    // Scalar reference pose: slerp and three matrix multiplies per joint, the way getPose composed poses before the kernel
+    inline void getPoseReference(const Model& model, const Animation& animation, float dt, std::vector<ChannelCursors>& cursors,
+        std::vector<glm::mat4>& globals, std::vector<glm::mat4>& output)
+    {
+        const Skeleton& skeleton = model.getSkeleton();
+        dt = fmod(dt, animation.duration);
+        for (int i = 0; i < skeleton.size(); i++) {
+            int parent = skeleton.parents[i];
+            glm::mat4 parentTransform = parent == Skeleton::NO_PARENT ? glm::mat4(1.0f) : globals[parent];
+            int channel = animation.jointChannels[i];
+            if (channel == NO_CHANNEL) {
+                globals[i] = parentTransform;
+                continue;
+            }
+            globals[i] = parentTransform * sampleJoint(animation, channel, dt, cursors[i]).toMatrix();
+            output[skeleton.boneIDs[i]] = globals[i] * skeleton.offsets[i];
+        }
+    }
+
+    // Checks the batched kernel against the scalar reference, then reports throughput in bones per second on one core
+    inline void runPoseKernelBenchmark(const Model& model, int iterations = 10000)
+    {
+        const Skeleton& skeleton = model.getSkeleton();
+        if (skeleton.empty()) {
+            cout << "BENCHMARK::POSE_KERNEL:: Model has no skeleton." << endl;
+            return;
+        }
+
+        AnimationInstance instance(&model);
+        int paletteSize = model.getBoneCount();
+        std::vector<glm::mat4> batched(paletteSize, glm::mat4(1.0f));
+        std::vector<glm::mat4> reference(paletteSize, glm::mat4(1.0f));
+        std::vector<glm::mat4> globals(skeleton.size(), glm::mat4(1.0f));
+        std::vector<ChannelCursors> cursors(skeleton.size());
+        const glm::mat4 identity = glm::mat4(1.0f);
+
+        for (const auto& pair : model.getAnimations()) {
+            const Animation& animation = pair.second;
+            float step = animation.duration / iterations;
+
+            float maxError = 0.0f;
+            for (int i = 0; i < iterations; i += 10) {
+                instance.getPose(animation, i * step, batched, identity);
+                getPoseReference(model, animation, i * step, cursors, globals, reference);
+                for (int b = 0; b < paletteSize; b++) {
+                    for (int column = 0; column < 4; column++) {
+                        maxError = std::max(maxError, glm::length(batched[b][column] - reference[b][column]));
+                    }
+                }
+            }
+
+            double referenceUs = measureMicroseconds(iterations, [&](int i) {
+                getPoseReference(model, animation, i * step, cursors, globals, reference);
+            });
+            double batchedUs = measureMicroseconds(iterations, [&](int i) {
+                instance.getPose(animation, i * step, batched, identity);
+            });
+
+            cout << "BENCHMARK::POSE_KERNEL:: " << pair.first << " (" << PoseKernel::instructionSet() << ")"
+                << " max error vs reference: " << maxError
+                << " reference: " << skeleton.size() / referenceUs << " M bones/s"
+                << " batched: " << skeleton.size() / batchedUs << " M bones/s" << endl;
+        }
+
+        // Kernel alone on a large synthetic batch, to compare instruction sets without the gather
+        const int laneCount = 4096;
+        PoseSamplingBatch batch;
+        batch.resize(laneCount);
+        for (int lane = 0; lane < laneCount; lane++) {
+            float angle = lane * 0.01f;
+            batch.setPositionKeys(lane, glm::vec3(lane, 0.0f, 1.0f), glm::vec3(lane, 1.0f, 0.0f), 0.3f);
+            batch.setRotationKeys(lane, glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)), glm::angleAxis(angle + 0.1f, glm::vec3(0.0f, 1.0f, 0.0f)), 0.6f);
+            batch.setScaleKeys(lane, glm::vec3(1.0f), glm::vec3(1.1f), 0.5f);
+        }
+        int kernelIterations = std::max(iterations / 10, 1);
+        double scalarUs = measureMicroseconds(kernelIterations, [&](int) {
+            PoseKernel::composeLocalTransformsScalar(batch);
+        });
+        double simdUs = measureMicroseconds(kernelIterations, [&](int) {
+            PoseKernel::composeLocalTransforms(batch);
+        });
+
+        cout << "BENCHMARK::POSE_KERNEL:: compose only, " << laneCount << " bones"
+            << " scalar: " << laneCount / scalarUs << " M bones/s"
+            << " " << PoseKernel::instructionSet() << ": " << laneCount / simdUs << " M bones/s" << endl;
+    }
+
+    // Updates a crowd of characters sharing one model with 1..N threads.
+    // Reports how many characters fit in the animation update of a 60 Hz frame at each thread count.
+    // maxThreads defaults to the hardware thread count.
+    inline void runCrowdUpdateBenchmark(const Model& model, int characters = 512, int frames = 200, int maxThreads = 0)
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::CROWD:: Model has no skeleton." << endl;
+            return;
+        }
+        if (model.getAnimations().empty()) {
+            cout << "BENCHMARK::CROWD:: Model has no animations." << endl;
+            return;
+        }
+
+        // Spread the crowd over every clip, each character a little out of phase with the last
+        std::vector<AnimationInstance> crowd;
+        crowd.reserve(characters);
+        const auto& animations = model.getAnimations();
+        auto clip = animations.begin();
+        for (int i = 0; i < characters; i++) {
+            crowd.emplace_back(&model);
+            crowd.back().setActiveAnimation(clip->first);
+            crowd.back().applyPose(i * 0.01f);
+            if (++clip == animations.end()) clip = animations.begin();
+        }
+
+        const float timeStep = 1.0f / 60.0f;
+        const double frameBudgetUs = 1000000.0 / 60.0;
+        auto update = [&](int i) {
+            crowd[i].updatePrevTransforms();
+            crowd[i].applyPose(timeStep);
+        };
+
+        if (maxThreads <= 0) {
+            maxThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+        }
+        double singleThreadUs = 0.0;
+        for (int threads = 1; threads <= maxThreads; threads++) {
+            JobSystem jobSystem(threads - 1);
+            double frameUs = measureMicroseconds(frames, [&](int) {
+                JobGroup group;
+                jobSystem.parallelFor(group, characters, ANIMATION_JOB_BATCH, update);
+                jobSystem.wait(group);
+            });
+            if (threads == 1) singleThreadUs = frameUs;
+
+            cout << "BENCHMARK::CROWD:: threads: " << threads << " characters: " << characters
+                << " update: " << frameUs << " us/frame"
+                << " characters per 60 Hz frame: " << static_cast<int>(characters * frameBudgetUs / frameUs)
+                << " speedup: " << singleThreadUs / frameUs << "x" << endl;
+        }
+    }
+
+    // Runs the CPU side of steady-state frames for a crowd sharing one model: parallel pose update, then the
+    // interpolated palette of every character, and counts heap allocations per frame once warmed up.
+    // Allocations are only counted in builds that define COUNT_ALLOCATIONS.
+    inline void runFrameAllocationCheck(Model& model, int characters = 64, int frames = 300, int warmupFrames = 10)
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::FRAME_ALLOCATIONS:: Model has no skeleton." << endl;
+            return;
+        }
+        if (!AllocationCounter::isEnabled()) {
+            cout << "BENCHMARK::FRAME_ALLOCATIONS:: Build without COUNT_ALLOCATIONS, nothing to count." << endl;
+            return;
+        }
+
+        std::vector<std::unique_ptr<AnimationInstance>> instances;
+        GameObjectManager manager;
+        for (int i = 0; i < characters; i++) {
+            instances.emplace_back(new AnimationInstance(&model));
+            manager.AddGameObject("Character", GameObject("Character", glm::vec3(i, 0.0f, 0.0f), glm::vec3(1.0f), glm::vec3(0.0f), &model, instances.back().get()));
+        }
+
+        JobSystem jobSystem;
+        FrameArena arena;
+        FrameAllocationCheck check(warmupFrames);
+        size_t maxAllocations = 0;
+        float checksum = 0.0f;  // Keeps the palettes from being optimized away
+        for (int frame = 0; frame < frames; frame++) {
+            check.beginFrame();
+            arena.reset();
+            manager.UpdateAnimations(1.0f / 60.0f, jobSystem);
+            for (const auto& instance : instances) {
+                checksum += instance->interpolateBoneTransformations(0.5f, arena)[0][3][0];
+            }
+            size_t allocations = check.endFrame();
+            if (frame >= warmupFrames) maxAllocations = std::max(maxAllocations, allocations);
+        }
+
+        cout << "BENCHMARK::FRAME_ALLOCATIONS:: characters: " << characters << " frames: " << frames - warmupFrames
+            << " allocations after warm-up: " << check.getSteadyStateAllocations()
+            << " worst frame: " << maxAllocations
+            << " arena high-water: " << arena.getHighWaterMark() << " bytes"
+            << " (checksum " << checksum << ")" << endl;
+    }
+
+    // Skins every vertex of the model on the CPU with both linear blend and dual quaternion skinning over a range
+    // of poses and compares the results. Vertices bound to a single bone must match; blended vertices differ by
+    // design, dual quaternions keep the volume that linear blending loses around twisting joints.
+    inline void runSkinningValidation(const Model& model, int posesPerClip = 20)
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::SKINNING:: Model has no skeleton." << endl;
+            return;
+        }
+
+        AnimationInstance instance(&model);
+        int paletteSize = model.getBoneCount();
+        std::vector<glm::mat4> palette(paletteSize, glm::mat4(1.0f));
+        std::vector<PackedDualQuaternion> dualQuaternions(paletteSize);
+
+        for (const auto& pair : model.getAnimations()) {
+            const Animation& animation = pair.second;
+            float rigidError = 0.0f;       // Largest difference on single-bone vertices
+            float blendedError = 0.0f;     // Largest difference on blended vertices
+            double totalError = 0.0;
+            size_t vertexCount = 0;
+            float nonRigidity = 0.0f;      // Largest scale or shear in the palette, which dual quaternions drop
+
+            for (int p = 0; p < posesPerClip; p++) {
+                instance.getPose(animation, animation.duration * p / posesPerClip, palette, glm::mat4(1.0f));
+                for (int b = 0; b < paletteSize; b++) {
+                    dualQuaternions[b] = packDualQuaternion(toDualQuaternion(palette[b]));
+                    // A rigid transform has orthonormal axes
+                    for (int i = 0; i < 3; i++) {
+                        for (int j = 0; j < 3; j++) {
+                            float axisDot = glm::dot(glm::vec3(palette[b][i]), glm::vec3(palette[b][j]));
+                            nonRigidity = std::max(nonRigidity, std::fabs(axisDot - (i == j ? 1.0f : 0.0f)));
+                        }
+                    }
+                }
+
+                for (const Mesh& mesh : model.meshes) {
+                    for (const Vertex& vertex : mesh.vertices) {
+                        glm::vec3 linearPosition, linearNormal, dualPosition, dualNormal;
+                        skinVertexLinear(palette.data(), vertex.BoneIDs, vertex.Weights, vertex.Position, vertex.Normal, linearPosition, linearNormal);
+                        skinVertexDualQuaternion(dualQuaternions.data(), vertex.BoneIDs, vertex.Weights, vertex.Position, vertex.Normal, dualPosition, dualNormal);
+
+                        float error = glm::length(linearPosition - dualPosition);
+                        float maxWeight = std::max(std::max(vertex.Weights[0], vertex.Weights[1]), std::max(vertex.Weights[2], vertex.Weights[3]));
+                        float& bucket = maxWeight > 0.999f ? rigidError : blendedError;
+                        bucket = std::max(bucket, error);
+                        totalError += error;
+                        vertexCount++;
+                    }
+                }
+            }
+
+            cout << "BENCHMARK::SKINNING:: " << pair.first << " dual quaternion vs linear blend over " << vertexCount << " vertices"
+                << " single-bone max: " << rigidError
+                << " blended max: " << blendedError
+                << " mean: " << (vertexCount ? totalError / vertexCount : 0.0)
+                << " palette non-rigidity: " << nonRigidity
+                << " bytes per bone: " << sizeof(glm::mat4) << " -> " << sizeof(PackedDualQuaternion) << endl;
+        }
+    }
+
+    // Skins the model's vertices, tiled up to minVertices, with the scalar reference, the lane kernel and the job pool.
+    // Checks the kernel against skinVertexLinear and reports skinned vertices per second per core.
+    inline void runCpuSkinningBenchmark(const Model& model, int minVertices = 65536, int iterations = 50)
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::CPU_SKINNING:: Model has no skeleton." << endl;
+            return;
+        }
+
+        std::vector<Vertex> vertices;
+        while (static_cast<int>(vertices.size()) < minVertices) {
+            size_t before = vertices.size();
+            for (const Mesh& mesh : model.meshes) {
+                vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            }
+            if (vertices.size() == before) {
+                cout << "BENCHMARK::CPU_SKINNING:: Model has no vertices." << endl;
+                return;
+            }
+        }
+        int vertexCount = static_cast<int>(vertices.size());
+
+        // Pose the palette somewhere inside the first clip
+        AnimationInstance instance(&model);
+        std::vector<glm::mat4> palette(model.getBoneCount(), glm::mat4(1.0f));
+        const Animation& animation = model.getAnimations().begin()->second;
+        instance.getPose(animation, animation.duration * 0.37f, palette, glm::mat4(1.0f));
+
+        SkinningInput input;
+        input.build(vertices);
+        SkinnedVertices scalarOutput, output;
+        SkinningKernel::skinVerticesScalar(input, palette.data(), scalarOutput);
+        SkinningKernel::skinVertices(input, palette.data(), output);
+
+        float positionError = 0.0f;
+        float normalError = 0.0f;
+        std::vector<glm::vec3> referencePositions(vertexCount), referenceNormals(vertexCount);
+        for (int i = 0; i < vertexCount; i++) {
+            const Vertex& vertex = vertices[i];
+            skinVertexLinear(palette.data(), vertex.BoneIDs, vertex.Weights, vertex.Position, vertex.Normal, referencePositions[i], referenceNormals[i]);
+            positionError = std::max(positionError, glm::length(output.getPosition(i) - referencePositions[i]));
+            normalError = std::max(normalError, glm::length(output.getNormal(i) - referenceNormals[i]) / std::max(glm::length(referenceNormals[i]), 1e-6f));
+        }
+        cout << "BENCHMARK::CPU_SKINNING:: " << PoseKernel::instructionSet() << " kernel vs reference over " << vertexCount << " vertices"
+            << " position max: " << positionError << " normal max (relative): " << normalError << endl;
+
+        double referenceUs = measureMicroseconds(iterations, [&](int) {
+            for (int i = 0; i < vertexCount; i++) {
+                const Vertex& vertex = vertices[i];
+                skinVertexLinear(palette.data(), vertex.BoneIDs, vertex.Weights, vertex.Position, vertex.Normal, referencePositions[i], referenceNormals[i]);
+            }
+        });
+        double scalarUs = measureMicroseconds(iterations, [&](int) {
+            SkinningKernel::skinVerticesScalar(input, palette.data(), scalarOutput);
+        });
+        double simdUs = measureMicroseconds(iterations, [&](int) {
+            SkinningKernel::skinVertices(input, palette.data(), output);
+        });
+
+        JobSystem jobSystem;
+        int threads = jobSystem.getThreadCount();
+        double parallelUs = measureMicroseconds(iterations, [&](int) {
+            SkinningKernel::skinVerticesParallel(jobSystem, input, palette.data(), output);
+        });
+
+        cout << "BENCHMARK::CPU_SKINNING:: per core"
+            << " reference: " << vertexCount / referenceUs << " M vertices/s"
+            << " scalar lanes: " << vertexCount / scalarUs << " M vertices/s"
+            << " " << PoseKernel::instructionSet() << ": " << vertexCount / simdUs << " M vertices/s" << endl;
+        cout << "BENCHMARK::CPU_SKINNING:: threads: " << threads
+            << " total: " << vertexCount / parallelUs << " M vertices/s"
+            << " per core: " << vertexCount / parallelUs / threads << " M vertices/s" << endl;
+    }
+
+    // Spreads a crowd from the camera out to maxDistance, every fourth character behind the camera, and compares
+    // the update of the whole crowd at full rate with the same update under animation LOD.
+    inline void runAnimationLodBenchmark(Model& model, int characters = 512, int frames = 200, float maxDistance = 200.0f,
+        const AnimationLodSettings& settings = AnimationLodSettings())
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::ANIMATION_LOD:: Model has no skeleton." << endl;
+            return;
+        }
+
+        std::vector<AnimationInstance> crowd;
+        crowd.reserve(characters);
+        GameObjectManager manager;
+        for (int i = 0; i < characters; i++) {
+            crowd.emplace_back(&model);
+            float distance = maxDistance * (i + 1) / characters;
+            glm::vec3 position(0.0f, 0.0f, i % 4 == 3 ? distance : -distance);
+            manager.AddGameObject("crowd", GameObject("crowd", position, glm::vec3(1.0f), glm::vec3(0.0f), &model, &crowd.back()));
+        }
+
+        // Camera at the origin looking down -z
+        glm::vec3 cameraPosition(0.0f);
+        glm::mat4 view = glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+        const float timeStep = 1.0f / 60.0f;
+        JobSystem jobSystem;
+        double fullUs = measureMicroseconds(frames, [&](int) {
+            manager.UpdateAnimations(timeStep, jobSystem);
+        });
+        AnimationLodStats full = manager.GetAnimationLodStats();
+
+        AnimationLodStats totals;
+        double lodUs = measureMicroseconds(frames, [&](int) {
+            manager.UpdateAnimations(timeStep, jobSystem, settings, cameraPosition, projection * view);
+            totals.add(manager.GetAnimationLodStats());
+        });
+
+        cout << "BENCHMARK::ANIMATION_LOD:: " << characters << " characters up to " << maxDistance << " units"
+            << " full rate: " << fullUs << " us/frame, " << full.jointEvaluations << " joint evaluations"
+            << " LOD: " << lodUs << " us/frame, " << totals.jointEvaluations / frames << " joint evaluations"
+            << " saved per frame: " << totals.jointEvaluationsSaved / frames
+            << " (evaluated " << totals.evaluated / frames << ", reduced rate " << totals.reducedRate / frames
+            << ", off-screen " << totals.offscreen / frames << " characters per frame)" << endl;
+    }
+
+    // Updates a crowd whose characters share a few clip phases, each jittered by less than a frame, without and
+    // with a pose cache. Reports update time, hit rate and how far the rounded cached poses are from exact ones.
+    inline void runPoseCacheBenchmark(const Model& model, int characters = 512, int frames = 200, int phases = 8,
+        const PoseCacheSettings& settings = PoseCacheSettings())
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::POSE_CACHE:: Model has no skeleton." << endl;
+            return;
+        }
+        if (model.getAnimations().empty()) {
+            cout << "BENCHMARK::POSE_CACHE:: Model has no animations." << endl;
+            return;
+        }
+
+        PoseCache cache(model.getBoneCount(), settings);
+        std::vector<AnimationInstance> exact, cached;
+        exact.reserve(characters);
+        cached.reserve(characters);
+        const auto& animations = model.getAnimations();
+        for (int i = 0; i < characters; i++) {
+            auto clip = animations.begin();
+            std::advance(clip, i % animations.size());
+            float phase = (i % phases) * 0.25f + (i % 7) * 0.0005f;
+            for (std::vector<AnimationInstance>* crowd : { &exact, &cached }) {
+                crowd->emplace_back(&model);
+                crowd->back().setActiveAnimation(clip->first);
+                crowd->back().update(phase);
+            }
+            cached.back().setPoseCache(&cache);
+        }
+        cache.resetStats();
+
+        const float timeStep = 1.0f / 60.0f;
+        JobSystem jobSystem;
+        auto updateCrowd = [&](std::vector<AnimationInstance>& crowd) {
+            auto update = [&](int i) {
+                crowd[i].update(timeStep);
+            };
+            JobGroup group;
+            jobSystem.parallelFor(group, characters, ANIMATION_JOB_BATCH, update);
+            jobSystem.wait(group);
+        };
+        double exactUs = measureMicroseconds(frames, [&](int) { updateCrowd(exact); });
+        double cachedUs = measureMicroseconds(frames, [&](int) { updateCrowd(cached); });
+
+        float maxError = 0.0f;
+        for (int i = 0; i < characters; i++) {
+            const std::vector<glm::mat4>& a = exact[i].getBoneTransforms();
+            const std::vector<glm::mat4>& b = cached[i].getBoneTransforms();
+            for (size_t bone = 0; bone < a.size(); bone++) {
+                for (int c = 0; c < 4; c++) {
+                    maxError = std::max(maxError, glm::length(a[bone][c] - b[bone][c]));
+                }
+            }
+        }
+
+        PoseCacheStats stats = cache.getStats();
+        cout << "BENCHMARK::POSE_CACHE:: " << characters << " characters in " << phases << " phases, quantum " << settings.timeQuantum
+            << " uncached: " << exactUs << " us/frame cached: " << cachedUs << " us/frame"
+            << " hit rate: " << stats.hitRate() * 100.0 << "% (" << stats.hits << " hits, " << stats.misses << " misses, "
+            << stats.evictions << " evictions, " << stats.entries << "/" << stats.capacity << " entries, " << stats.sizeInBytes << " bytes)"
+            << " max error vs exact: " << maxError << endl;
+    }
+
+    // Switches between the first two clips of the model at once and with a cross-fade, and reports the largest
+    // change of any palette matrix over one update around the switch next to the largest one in steady playback.
+    // Also times a plain, a cross-faded and a cross-faded plus additive pose, and counts heap allocations during
+    // the blended updates in builds that define COUNT_ALLOCATIONS.
+    inline void runCrossFadeBenchmark(const Model& model, float fadeDuration = DEFAULT_CROSS_FADE_DURATION, int iterations = 2000)
+    {
+        if (!model.hasSkeleton() || model.getAnimations().size() < 2) {
+            cout << "BENCHMARK::CROSS_FADE:: Model needs a skeleton and two clips." << endl;
+            return;
+        }
+
+        auto clip = model.getAnimations().begin();
+        const std::string from = clip->first;
+        const std::string to = (++clip)->first;
+        const float timeStep = 1.0f / 60.0f;
+
+        auto largestStep = [](const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) {
+            float step = 0.0f;
+            for (size_t bone = 0; bone < a.size(); bone++) {
+                for (int c = 0; c < 4; c++) {
+                    step = std::max(step, glm::length(a[bone][c] - b[bone][c]));
+                }
+            }
+            return step;
+        };
+
+        // Step of the last update before switching, then the largest step over the switch and the fade after it
+        auto measureSwitch = [&](float duration, float& steadyStep) {
+            AnimationInstance instance(&model);
+            instance.setActiveAnimation(from, 0.0f);
+            instance.applyPose(0.0f);
+            std::vector<glm::mat4> last = instance.getBoneTransforms();
+            for (int i = 0; i < 10; i++) {
+                instance.applyPose(timeStep);
+                steadyStep = largestStep(last, instance.getBoneTransforms());
+                last = instance.getBoneTransforms();
+            }
+
+            instance.setActiveAnimation(to, duration);
+            float switchStep = 0.0f;
+            int steps = static_cast<int>(duration / timeStep) + 10;
+            for (int i = 0; i < steps; i++) {
+                instance.applyPose(timeStep);
+                switchStep = std::max(switchStep, largestStep(last, instance.getBoneTransforms()));
+                last = instance.getBoneTransforms();
+            }
+            return switchStep;
+        };
+
+        float steadyStep = 0.0f;
+        float instantStep = measureSwitch(0.0f, steadyStep);
+        float fadedStep = measureSwitch(fadeDuration, steadyStep);
+
+        // Cost of one pose: a single clip, a fade that never finishes, and the same fade with an additive layer on top
+        AnimationInstance plain(&model);
+        plain.setActiveAnimation(from, 0.0f);
+        AnimationInstance fading(&model);
+        fading.setActiveAnimation(from, 0.0f);
+        fading.setActiveAnimation(to, 1e9f);
+        AnimationInstance layered(&model);
+        layered.setActiveAnimation(from, 0.0f);
+        layered.setActiveAnimation(to, 1e9f);
+        layered.setAdditiveLayer(0, from, 0.5f);
+
+        double plainUs = measureMicroseconds(iterations, [&](int) { plain.applyPose(timeStep); });
+        double fadingUs = measureMicroseconds(iterations, [&](int) { fading.applyPose(timeStep); });
+
+        FrameAllocationCheck check(1);
+        double layeredUs = measureMicroseconds(iterations, [&](int) {
+            check.beginFrame();
+            layered.applyPose(timeStep);
+            check.endFrame();
+        });
+
+        cout << "BENCHMARK::CROSS_FADE:: " << from << " -> " << to << ", " << model.getSkeleton().size() << " joints"
+            << " largest bone step per update, before the switch: " << steadyStep << " instant switch: " << instantStep
+            << " fade over " << fadeDuration << ": " << fadedStep << endl;
+        cout << "BENCHMARK::CROSS_FADE:: pose cost, single clip: " << plainUs << " us cross-fade: " << fadingUs
+            << " us cross-fade + additive layer: " << layeredUs << " us";
+        if (AllocationCounter::isEnabled()) {
+            cout << " allocations while blending: " << check.getSteadyStateAllocations();
+        }
+        cout << endl;
+    }
+
+    // Cost of the switch call gameplay code makes on every input event, by clip name and by AnimationState.
+    // Most calls ask for the clip already playing, so alternate between runs of repeated requests.
+    inline void runClipSwitchBenchmark(const Model& model, int iterations = 1000000)
+    {
+        if (model.getStateClip(IDLE) == NO_CLIP || model.getStateClip(WALKING) == NO_CLIP) {
+            cout << "BENCHMARK::CLIP_SWITCH:: Model has no idle or walking clip." << endl;
+            return;
+        }
+
+        AnimationInstance instance(&model);
+        double byNameUs = measureMicroseconds(iterations, [&](int i) {
+            instance.setActiveAnimation(getAnimationString((i >> 6) & 1 ? WALKING : IDLE), 0.0f);
+        });
+        double byStateUs = measureMicroseconds(iterations, [&](int i) {
+            instance.setActiveAnimation((i >> 6) & 1 ? WALKING : IDLE, 0.0f);
+        });
+
+        cout << "BENCHMARK::CLIP_SWITCH:: " << model.getClipCount() << " clips"
+            << " by name: " << byNameUs * 1000.0 << " ns/call by state: " << byStateUs * 1000.0 << " ns/call" << endl;
+    }
+
+    // Skins every vertex of the model at times spread over each clip, off the bounds sample grid, and checks that
+    // they stay inside the clip bounds for that time. Reports vertices outside, how far out the worst one is, how
+    // much larger the segment boxes are than the skinned extents, and what recomputing the bounds costs.
+    inline void runAnimatedBoundsCheck(Model& model, int posesPerClip = 97)
+    {
+        if (!model.hasSkeleton()) {
+            cout << "BENCHMARK::ANIMATED_BOUNDS:: Model has no skeleton." << endl;
+            return;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        model.computeAnimatedBounds();
+        double computeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::vector<Vertex> vertices;
+        for (const Mesh& mesh : model.meshes) {
+            vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        }
+        SkinningInput input;
+        input.build(vertices);
+        SkinnedVertices output;
+
+        AnimationInstance instance(&model);
+        std::vector<glm::mat4> palette(model.getBoneCount());
+        for (const auto& pair : model.getAnimations()) {
+            const Animation& animation = pair.second;
+            int outside = 0;
+            float worstDistance = 0.0f;
+            double boxVolume = 0.0;
+            double skinnedVolume = 0.0;
+            for (int p = 0; p < posesPerClip; p++) {
+                float time = animation.duration * (p + 0.5f) / posesPerClip;
+                std::fill(palette.begin(), palette.end(), glm::mat4(1.0f));
+                instance.getPose(animation, time, palette, glm::mat4(1.0f));
+                SkinningKernel::skinVerticesScalar(input, palette.data(), output);
+
+                const BoundingBox& box = animation.bounds.getBounds(time);
+                BoundingBox skinned;
+                for (int i = 0; i < output.count; i++) {
+                    glm::vec3 position = output.getPosition(i);
+                    skinned.expand(position);
+                    glm::vec3 out = glm::max(box.min - position, position - box.max);
+                    float distance = std::max(std::max(out.x, out.y), out.z);
+                    if (distance > 0.0f) {
+                        outside++;
+                        worstDistance = std::max(worstDistance, distance);
+                    }
+                }
+                boxVolume += box.getVolume();
+                skinnedVolume += skinned.getVolume();
+            }
+
+            cout << "BENCHMARK::ANIMATED_BOUNDS:: " << pair.first << " " << animation.bounds.segments.size() << " segments"
+                << " vertices outside: " << outside << " of " << output.count * posesPerClip
+                << " worst: " << worstDistance
+                << " box / skinned volume: " << (skinnedVolume > 0.0 ? boxVolume / skinnedVolume : 0.0)
+                << " clip box / bind box volume: " << animation.bounds.clip.getVolume() / std::max(model.getBindBounds().getVolume(), 1e-12f) << endl;
+        }
+        cout << "BENCHMARK::ANIMATED_BOUNDS:: computed for " << model.getClipCount() << " clips in " << computeMs << " ms" << endl;
+    }
+}
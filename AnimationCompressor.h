@@ -0,0 +1,220 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "Animation.h"
+
+struct ClipCompressionSettings
+{
+    float sampleRate = 30.0f;               // Resampled frames per second
+    float translationErrorBound = 0.0005f;  // Largest allowed position error per track, in model units
+    float rotationErrorBound = 0.0005f;     // Largest allowed rotation error per track, in radians
+    float scaleErrorBound = 0.0001f;        // Largest allowed scale error per track
+    float shellDistance = 1.0f;             // Distance from the joint of the virtual vertices used to measure bone-space error
+    bool releaseSourceTracks = false;       // Free the keyframe arrays once the clip is packed
+};
+
+struct ClipCompressionReport
+{
+    size_t sourceBytes = 0;
+    size_t compressedBytes = 0;
+    int totalTracks = 0;
+    int constantTracks = 0;
+    float maxBoneSpaceError = 0.0f;  // Largest displacement of a virtual vertex at shellDistance, in model units
+};
+
+// Angle between two rotations in radians.
+// Computed from the chord between the unit quaternions, acos of their dot product is too imprecise near zero.
+inline float rotationError(const glm::quat& a, const glm::quat& b)
+{
+    glm::quat aligned = glm::dot(a, b) < 0.0f ? -b : b;
+    glm::quat difference = a - aligned;
+    float chord = std::sqrt(glm::dot(difference, difference));
+    return 4.0f * std::asin(std::min(chord * 0.5f, 1.0f));
+}
+
+// Picks the smallest vector format that keeps every resampled frame within the bound
+inline PackedTrack chooseVec3Format(const std::vector<glm::vec3>& samples, float errorBound)
+{
+    PackedTrack track;
+    glm::vec3 minValue = samples[0];
+    glm::vec3 maxValue = samples[0];
+    float constantError = 0.0f;
+    for (const glm::vec3& sample : samples) {
+        minValue = glm::min(minValue, sample);
+        maxValue = glm::max(maxValue, sample);
+        constantError = std::max(constantError, glm::length(sample - samples[0]));
+    }
+
+    if (constantError <= errorBound) {
+        track.format = TRACK_CONSTANT;
+        track.constant = glm::vec4(samples[0], 0.0f);
+        return track;
+    }
+
+    track.rangeMin = minValue;
+    track.rangeExtent = maxValue - minValue;
+
+    const TrackFormat candidates[] = { TRACK_QUANTIZED_8, TRACK_QUANTIZED_16 };
+    for (TrackFormat format : candidates) {
+        track.format = format;
+        uint8_t packed[12];
+        float maxError = 0.0f;
+        for (const glm::vec3& sample : samples) {
+            packVec3(track, sample, packed);
+            maxError = std::max(maxError, glm::length(unpackVec3(track, packed) - sample));
+        }
+        if (maxError <= errorBound) return track;
+    }
+
+    track.format = TRACK_RAW;
+    return track;
+}
+
+inline PackedTrack chooseRotationFormat(const std::vector<glm::quat>& samples, float errorBound)
+{
+    PackedTrack track;
+    float constantError = 0.0f;
+    for (const glm::quat& sample : samples) {
+        constantError = std::max(constantError, rotationError(sample, samples[0]));
+    }
+
+    if (constantError <= errorBound) {
+        track.format = TRACK_CONSTANT;
+        track.constant = glm::vec4(samples[0].x, samples[0].y, samples[0].z, samples[0].w);
+        return track;
+    }
+
+    track.format = TRACK_QUANTIZED_16;
+    uint16_t packed[3];
+    for (const glm::quat& sample : samples) {
+        packQuat48(sample, packed);
+        if (rotationError(unpackQuat48(packed), sample) > errorBound) {
+            track.format = TRACK_RAW;
+            break;
+        }
+    }
+    return track;
+}
+
+// Assigns the track its slot in the packed frame
+inline void placeTrack(PackedTrack& track, bool isRotation, uint32_t& frameStride, ClipCompressionReport& report)
+{
+    report.totalTracks++;
+    if (track.format == TRACK_CONSTANT) {
+        report.constantTracks++;
+        return;
+    }
+    track.frameOffset = frameStride;
+    frameStride += packedTrackSize(track.format, isRotation);
+}
+
+// Largest distance between virtual vertices around the joint transformed by the source and the packed pose
+inline float boneSpaceError(const JointPose& source, const JointPose& packed, float shellDistance)
+{
+    glm::mat4 a = source.toMatrix();
+    glm::mat4 b = packed.toMatrix();
+    float maxError = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec4 vertex(0.0f, 0.0f, 0.0f, 1.0f);
+        vertex[axis] = shellDistance;
+        maxError = std::max(maxError, glm::length(glm::vec3(a * vertex) - glm::vec3(b * vertex)));
+    }
+    return maxError;
+}
+
+// Resamples every channel of the animation at a fixed rate and packs it into animation.compressed.
+// Constant tracks are dropped from the stream, the rest get the smallest format within their error bound.
+inline ClipCompressionReport compressAnimation(Animation& animation, const ClipCompressionSettings& settings)
+{
+    ClipCompressionReport report;
+
+    // Frame grid spanning the keys of every channel
+    float startTime = 0.0f;
+    float endTime = 0.0f;
+    bool hasKeys = false;
+    for (const BoneTransformTrack& track : animation.channels) {
+        report.sourceBytes += track.sizeInBytes();
+        const std::vector<float>* timestamps[] = { &track.positionTimestamps, &track.rotationTimestamps, &track.scaleTimestamps };
+        for (const std::vector<float>* times : timestamps) {
+            if (times->empty()) continue;
+            startTime = hasKeys ? std::min(startTime, times->front()) : times->front();
+            endTime = hasKeys ? std::max(endTime, times->back()) : times->back();
+            hasKeys = true;
+        }
+    }
+    if (!hasKeys) return report;  // Nothing to pack, or the source tracks were already released
+
+    CompressedClip& clip = animation.compressed;
+    clip = CompressedClip();
+    clip.startTime = startTime;
+    clip.frameInterval = animation.ticksPerSecond / settings.sampleRate;
+    clip.frameCount = static_cast<uint32_t>(std::ceil((endTime - startTime) / clip.frameInterval)) + 1;
+
+    // Resample and choose a format per track
+    size_t channelCount = animation.channels.size();
+    std::vector<std::vector<JointPose>> samples(channelCount, std::vector<JointPose>(clip.frameCount));
+    clip.channels.resize(channelCount);
+    for (size_t c = 0; c < channelCount; c++) {
+        ChannelCursors cursors;
+        std::vector<glm::vec3> positions(clip.frameCount);
+        std::vector<glm::quat> rotations(clip.frameCount);
+        std::vector<glm::vec3> scales(clip.frameCount);
+        for (uint32_t f = 0; f < clip.frameCount; f++) {
+            JointPose pose = sampleChannel(animation.channels[c], startTime + f * clip.frameInterval, cursors);
+            // Keep consecutive rotations in the same hemisphere so frames can be interpolated directly
+            if (f > 0 && glm::dot(pose.rotation, rotations[f - 1]) < 0.0f) {
+                pose.rotation = -pose.rotation;
+            }
+            samples[c][f] = pose;
+            positions[f] = pose.position;
+            rotations[f] = pose.rotation;
+            scales[f] = pose.scale;
+        }
+
+        PackedChannel& packed = clip.channels[c];
+        packed.position = chooseVec3Format(positions, settings.translationErrorBound);
+        packed.rotation = chooseRotationFormat(rotations, settings.rotationErrorBound);
+        packed.scale = chooseVec3Format(scales, settings.scaleErrorBound);
+        placeTrack(packed.position, false, clip.frameStride, report);
+        placeTrack(packed.rotation, true, clip.frameStride, report);
+        placeTrack(packed.scale, false, clip.frameStride, report);
+    }
+
+    // Write the stream frame by frame
+    clip.frames.resize(static_cast<size_t>(clip.frameCount) * clip.frameStride);
+    for (uint32_t f = 0; f < clip.frameCount; f++) {
+        uint8_t* frame = clip.frames.data() + static_cast<size_t>(f) * clip.frameStride;
+        for (size_t c = 0; c < channelCount; c++) {
+            const PackedChannel& packed = clip.channels[c];
+            const JointPose& pose = samples[c][f];
+            if (packed.position.format != TRACK_CONSTANT) packVec3(packed.position, pose.position, frame + packed.position.frameOffset);
+            if (packed.rotation.format != TRACK_CONSTANT) packRotation(packed.rotation, pose.rotation, frame + packed.rotation.frameOffset);
+            if (packed.scale.format != TRACK_CONSTANT) packVec3(packed.scale, pose.scale, frame + packed.scale.frameOffset);
+        }
+    }
+    report.compressedBytes = clip.sizeInBytes();
+
+    // Measure the decoded result against the source keys, on the frame grid and halfway between frames
+    for (size_t c = 0; c < channelCount; c++) {
+        ChannelCursors cursors;
+        for (uint32_t f = 0; f < clip.frameCount * 2; f++) {
+            float time = std::min(startTime + f * clip.frameInterval * 0.5f, endTime);
+            JointPose source = sampleChannel(animation.channels[c], time, cursors);
+            JointPose decoded = clip.sampleChannel(static_cast<int>(c), time);
+            report.maxBoneSpaceError = std::max(report.maxBoneSpaceError, boneSpaceError(source, decoded, settings.shellDistance));
+        }
+    }
+
+    if (settings.releaseSourceTracks) {
+        for (BoneTransformTrack& track : animation.channels) {
+            track = BoneTransformTrack();
+        }
+    }
+
+    return report;
+}
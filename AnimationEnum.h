@@ -5,7 +5,8 @@
 enum AnimationState
 {
     IDLE,
-    WALKING
+    WALKING,
+    ANIMATION_STATE_COUNT
 };
 
 inline const std::string getAnimationString(AnimationState state)
@@ -0,0 +1,434 @@
+#include "AnimationInstance.h"
+
+AnimationInstance::AnimationInstance(const Model* model, bool modelLoading) : model(model)
+{
+    bindModel(modelLoading);
+}
+
+bool AnimationInstance::bindModel(bool modelLoading)
+{
+    if (modelBound) return true;
+    if (!modelLoading && !model->isReady()) return false;
+    modelBound = true;
+
+    const Skeleton& skeleton = model->getSkeleton();
+    boneTransforms.resize(model->getBoneCount(), glm::mat4(1.0f));
+    if (model->getBoneCount() > MAX_BONES) {
+        cout << "WARNING::ANIMATION:: Model has " << model->getBoneCount() << " bones, only the first " << MAX_BONES << " are skinned." << endl;
+    }
+    prevBoneTransforms = boneTransforms;
+    globalTransforms.resize(skeleton.size(), glm::mat4(1.0f));
+    keyframeCursors.resize(skeleton.size());
+    poseBatch.resize(skeleton.size());
+    fadeCursors.resize(skeleton.size());
+    fadeBatch.resize(skeleton.size());
+    blendBatch.resize(skeleton.size());
+    jointHeights = skeleton.computeJointHeights();
+
+    if (poseCache) {
+        setPoseCache(poseCache);  // Set before the model was ready, check it against the bone count now
+    }
+    setActiveAnimation(IDLE);
+    return true;
+}
+
+void AnimationInstance::applyPose(float timeStep)
+{
+    if (!bindModel() || !currentAnimation) return;
+
+    if (releasedBones) {
+        freezeReleasedBones();
+    }
+
+    advanceTime(timeStep);
+
+    float adjustedTime = currentAnimationTime;
+    glm::mat4 inverseIdentityMatrix = glm::inverse(glm::mat4(1.0f));
+    poseFromCache = false;
+    if (fadeAnimation || activeLayers > 0) {
+        getBlendedPose(boneTransforms, inverseIdentityMatrix);
+        if (fadeAnimation && fadeElapsed >= fadeDuration) {
+            // This pose already had the new clip at full weight
+            fadeAnimation = nullptr;
+            releasedBones = true;
+        }
+        return;
+    }
+    if (poseCache) {
+        PoseCache::Key key = poseCache->makeKey(*currentAnimation, adjustedTime);
+        if (poseCache->fetch(key, boneTransforms.data())) {
+            poseFromCache = true;
+            // The batch lanes were not refreshed, the next miss gathers every joint again
+            leafKeysGathered = false;
+            return;
+        }
+        adjustedTime = poseCache->getKeyTime(key);
+        skippedJoints = 0;
+        getPose(*currentAnimation, adjustedTime, boneTransforms, inverseIdentityMatrix);
+        // A pose with skipped leaf joints is only good enough for this instance
+        if (skippedJoints == 0) {
+            poseCache->store(key, boneTransforms.data());
+        }
+        return;
+    }
+    getPose(*currentAnimation, adjustedTime, boneTransforms, inverseIdentityMatrix);
+}
+
+void AnimationInstance::setPoseCache(PoseCache* cache)
+{
+    if (!modelBound) {
+        poseCache = cache;  // Checked by bindModel
+        return;
+    }
+    if (cache && cache->getBoneCount() != model->getBoneCount()) {
+        cout << "WARNING::ANIMATION:: Pose cache holds " << cache->getBoneCount() << " bones, the model has " << model->getBoneCount() << ". Cache not used." << endl;
+        cache = nullptr;
+    }
+    poseCache = cache;
+}
+
+void AnimationInstance::setActiveClip(ClipHandle clip)
+{
+    setActiveClip(clip, crossFadeDuration);
+}
+
+void AnimationInstance::setActiveClip(ClipHandle clip, float fadeDuration)
+{
+    if (!bindModel() || clip == currentClip) return;
+    const Animation* animation = model->getClip(clip);
+    if (!animation) return;
+
+    if (currentAnimation && fadeDuration > 0.0f) {
+        // The clip playing now keeps playing while it fades out
+        fadeAnimation = currentAnimation;
+        fadeAnimationTime = currentAnimationTime;
+        fadeCursors = keyframeCursors;  // Same size, copied in place
+        fadeElapsed = 0.0f;
+        this->fadeDuration = fadeDuration;
+    }
+    else {
+        fadeAnimation = nullptr;
+    }
+    releasedBones = true;
+
+    currentClip = clip;
+    currentAnimation = animation;
+    currentAnimationTime = 0.0f;  // Reset only when changing animations
+    std::fill(keyframeCursors.begin(), keyframeCursors.end(), ChannelCursors());
+    leafKeysGathered = false;
+}
+
+void AnimationInstance::setActiveAnimation(AnimationState state)
+{
+    if (!bindModel()) return;
+    setActiveClip(model->getStateClip(state), crossFadeDuration);
+}
+
+void AnimationInstance::setActiveAnimation(AnimationState state, float fadeDuration)
+{
+    if (!bindModel()) return;
+    setActiveClip(model->getStateClip(state), fadeDuration);
+}
+
+void AnimationInstance::setActiveAnimation(const std::string& name)
+{
+    if (!bindModel()) return;
+    setActiveClip(model->findClip(name), crossFadeDuration);
+}
+
+void AnimationInstance::setActiveAnimation(const std::string& name, float fadeDuration)
+{
+    if (!bindModel()) return;
+    setActiveClip(model->findClip(name), fadeDuration);
+}
+
+bool AnimationInstance::setAdditiveLayer(int layer, const std::string& name, float weight)
+{
+    if (!bindModel()) return false;
+    ClipHandle clip = model->findClip(name);
+    if (clip == NO_CLIP) {
+        cout << "WARNING::ANIMATION:: No animation named " << name << " for additive layer " << layer << "." << endl;
+        return false;
+    }
+    return setAdditiveLayer(layer, clip, weight);
+}
+
+bool AnimationInstance::setAdditiveLayer(int layer, ClipHandle clip, float weight)
+{
+    if (layer < 0 || layer >= MAX_ADDITIVE_LAYERS) {
+        cout << "WARNING::ANIMATION:: Additive layer " << layer << " out of range, " << MAX_ADDITIVE_LAYERS << " layers available." << endl;
+        return false;
+    }
+    if (!bindModel()) return false;
+    const Animation* animation = model->getClip(clip);
+    if (!animation) {
+        cout << "WARNING::ANIMATION:: No clip " << clip << " for additive layer " << layer << "." << endl;
+        return false;
+    }
+
+    AdditiveLayer& additive = additiveLayers[layer];
+    if (additive.animation) {
+        releasedBones = true;
+    }
+    else {
+        activeLayers++;
+    }
+    additive.animation = animation;
+    additive.weight = weight;
+    additive.time = 0.0f;
+
+    int jointCount = model->getSkeleton().size();
+    if (additive.batch.count != jointCount) {
+        additive.batch.resize(jointCount);
+        additive.reference.resize(jointCount);
+        additive.cursors.resize(jointCount);
+    }
+    std::fill(additive.cursors.begin(), additive.cursors.end(), ChannelCursors());
+
+    // The layer adds its difference from its own first frame
+    gatherPose(*animation, 0.0f, additive.batch, additive.cursors, 0);
+    PoseKernel::sampleLocalPoses(additive.batch, additive.reference, 0);
+    return true;
+}
+
+void AnimationInstance::setAdditiveLayerWeight(int layer, float weight)
+{
+    if (layer >= 0 && layer < MAX_ADDITIVE_LAYERS) {
+        additiveLayers[layer].weight = weight;
+    }
+}
+
+void AnimationInstance::clearAdditiveLayer(int layer)
+{
+    if (layer >= 0 && layer < MAX_ADDITIVE_LAYERS && additiveLayers[layer].animation) {
+        additiveLayers[layer].animation = nullptr;
+        activeLayers--;
+        releasedBones = true;
+    }
+}
+
+void AnimationInstance::update(float timeStep, const AnimationLod& lod)
+{
+    if (!bindModel()) {
+        lastUpdateStats = AnimationLodStats();
+        return;
+    }
+    int jointCount = model->getSkeleton().size();
+    lastUpdateStats = AnimationLodStats();
+    lastUpdateStats.instances = 1;
+    pendingTime += timeStep;
+
+    if (!lod.visible) {
+        // Nothing to draw, keep the clock running and start from a fresh pose once the object is back in view
+        advanceTime(pendingTime);
+        pendingTime = 0.0f;
+        poseStale = true;
+        lastUpdateStats.offscreen = 1;
+        lastUpdateStats.jointEvaluationsSaved = jointCount;
+        return;
+    }
+
+    if (!poseStale && ++updatesSinceEvaluation < lod.updateInterval) {
+        lastUpdateStats.reducedRate = 1;
+        lastUpdateStats.jointEvaluationsSaved = jointCount;
+        return;
+    }
+
+    updatePrevTransforms();
+    skippedJointLevels = lod.skippedJointLevels;
+    skippedJoints = 0;
+    float elapsed = pendingTime;
+    pendingTime = 0.0f;
+    applyPose(elapsed);
+    if (poseStale) {
+        std::copy(boneTransforms.begin(), boneTransforms.end(), prevBoneTransforms.begin());
+        poseStale = false;
+    }
+    updateInterval = lod.updateInterval;
+    updatesSinceEvaluation = 0;
+
+    lastUpdateStats.evaluated = 1;
+    lastUpdateStats.jointEvaluations = poseFromCache ? 0 : jointCount - skippedJoints;
+    lastUpdateStats.jointEvaluationsSaved = poseFromCache ? jointCount : skippedJoints;
+}
+
+void AnimationInstance::updatePrevTransforms()
+{
+    // Current transforms become the previous ones, the next getPose overwrites the other buffer
+    boneTransforms.swap(prevBoneTransforms);
+}
+
+const glm::mat4* AnimationInstance::interpolateBoneTransformations(float alpha, FrameArena& arena) const
+{
+    // Interpolate between previous and current bone transformations based on alpha,
+    // stretched over all updates since the last evaluation when running at a reduced rate
+    float factor = std::min((updatesSinceEvaluation + alpha) / updateInterval, 1.0f);
+    glm::mat4* interpolatedTransforms = arena.allocate<glm::mat4>(boneTransforms.size());
+    for (size_t i = 0; i < boneTransforms.size(); ++i) {
+        interpolatedTransforms[i] = lerp(prevBoneTransforms[i], boneTransforms[i], factor);
+    }
+    return interpolatedTransforms;
+}
+
+void AnimationInstance::uploadBoneTransformations(Shader& shader, float alpha, FrameArena& arena)
+{
+    updateBoneTransformations(shader, interpolateBoneTransformations(alpha, arena), static_cast<int>(boneTransforms.size()));
+}
+
+void AnimationInstance::getPose(const Animation& animation, float dt, std::vector<glm::mat4>& output, const glm::mat4& globalInverseTransform)
+{
+    dt = fmod(dt, animation.duration);  // Wrap time around the duration
+
+    // Sample and compose the local transform of every joint in one batched pass
+    gatherPose(animation, dt, poseBatch, keyframeCursors, getLeafHeight(animation));
+    PoseKernel::composeLocalTransforms(poseBatch);
+    storePalette(poseBatch, animation, false, output, globalInverseTransform);
+}
+
+// Samples the active clip, the clip fading out and every additive layer into local poses, blends them
+// joint by joint in blendBatch and composes the result, with the same batched kernels as a single clip
+void AnimationInstance::getBlendedPose(std::vector<glm::mat4>& output, const glm::mat4& globalInverseTransform)
+{
+    const Animation& animation = *currentAnimation;
+    gatherPose(animation, fmod(currentAnimationTime, animation.duration), poseBatch, keyframeCursors, getLeafHeight(animation));
+
+    if (fadeAnimation) {
+        gatherPose(*fadeAnimation, fmod(fadeAnimationTime, fadeAnimation->duration), fadeBatch, fadeCursors, 0);
+        PoseKernel::sampleLocalPoses(fadeBatch, blendBatch, 0);
+        PoseKernel::sampleLocalPoses(poseBatch, blendBatch, 1);
+        blendBatch.setBlendWeight(std::min(fadeElapsed / fadeDuration, 1.0f));
+        if (activeLayers > 0) {
+            // Layers add onto the blended pose
+            PoseKernel::sampleLocalPoses(blendBatch, blendBatch, 0);
+            blendBatch.setBlendWeight(0.0f);
+        }
+    }
+    else {
+        PoseKernel::sampleLocalPoses(poseBatch, blendBatch, 0);
+        blendBatch.setBlendWeight(0.0f);
+    }
+
+    for (AdditiveLayer& layer : additiveLayers) {
+        if (!layer.animation || layer.weight == 0.0f) continue;
+        gatherPose(*layer.animation, layer.time, layer.batch, layer.cursors, 0);
+        PoseKernel::sampleLocalPoses(layer.batch, layer.batch, 0);
+        PoseKernel::addLocalPoses(blendBatch, layer.batch, layer.reference, layer.weight);
+    }
+
+    PoseKernel::composeLocalTransforms(blendBatch);
+    storePalette(blendBatch, animation, true, output, globalInverseTransform);
+}
+
+// Chains the composed local transforms of the batch into the palette.
+// Only joints the animation animates are written, or while blending joints any blended clip animates.
+void AnimationInstance::storePalette(const PoseSamplingBatch& batch, const Animation& animation, bool blended, std::vector<glm::mat4>& output, const glm::mat4& globalInverseTransform)
+{
+    const Skeleton& skeleton = model->getSkeleton();
+
+    // Joints are topologically sorted, so every parent's global transform is ready before its children
+    for (int i = 0; i < skeleton.size(); i++) {
+        int parent = skeleton.parents[i];
+        const glm::mat4& parentTransform = parent == Skeleton::NO_PARENT ? identityTransform : globalTransforms[parent];
+
+        if (animation.jointChannels[i] == NO_CHANNEL && !(blended && isJointBlended(i))) {
+            // If no animation data for this bone, use parent transform for children
+            globalTransforms[i] = parentTransform;
+            continue;
+        }
+
+        globalTransforms[i] = parentTransform * batch.getLocalTransform(i);
+        output[skeleton.boneIDs[i]] = globalInverseTransform * globalTransforms[i] * skeleton.offsets[i];
+    }
+}
+
+bool AnimationInstance::isJointBlended(int joint) const
+{
+    if (fadeAnimation && fadeAnimation->jointChannels[joint] != NO_CHANNEL) return true;
+    for (const AdditiveLayer& layer : additiveLayers) {
+        if (layer.animation && layer.animation->jointChannels[joint] != NO_CHANNEL) return true;
+    }
+    return false;
+}
+
+// After a switch, a finished fade or a removed layer, bones the next evaluation will not write
+// are frozen at the same value in both palettes so interpolation does not flicker between them
+void AnimationInstance::freezeReleasedBones()
+{
+    const Skeleton& skeleton = model->getSkeleton();
+    for (int i = 0; i < skeleton.size(); i++) {
+        if (currentAnimation->jointChannels[i] == NO_CHANNEL && !isJointBlended(i)) {
+            int bone = skeleton.boneIDs[i];
+            boneTransforms[bone] = prevBoneTransforms[bone];
+        }
+    }
+    releasedBones = false;
+}
+
+void AnimationInstance::advanceTime(float timeStep)
+{
+    if (!currentAnimation) return;
+
+    auto advance = [timeStep](float& time, const Animation& animation) {
+        time += timeStep;
+        if (time > animation.duration) {
+            time = fmod(time, animation.duration);
+        }
+    };
+
+    advance(currentAnimationTime, *currentAnimation);
+    if (fadeAnimation) {
+        advance(fadeAnimationTime, *fadeAnimation);
+        fadeElapsed += timeStep;
+    }
+    for (AdditiveLayer& layer : additiveLayers) {
+        if (layer.animation) advance(layer.time, *layer.animation);
+    }
+}
+
+// Joints within skippedJointLevels of the end of their chain are left out once the active clip's keys have
+// been gathered in full, their lanes keep the keys already there and are recomposed but not resampled
+int AnimationInstance::getLeafHeight(const Animation& animation)
+{
+    bool isActive = &animation == currentAnimation;
+    int minHeight = isActive && leafKeysGathered ? skippedJointLevels : 0;
+    leafKeysGathered = isActive;
+    return minHeight;
+}
+
+// Gathers the keys of every joint into the batch, one lane per joint. Joints the clip does not animate get
+// identity keys, so blending towards a clip that leaves a joint out blends towards its parent's space.
+// Joints of height below minHeight are skipped and keep the keys already in their lane.
+void AnimationInstance::gatherPose(const Animation& animation, float dt, PoseSamplingBatch& batch, std::vector<ChannelCursors>& cursors, int minHeight)
+{
+    const Skeleton& skeleton = model->getSkeleton();
+
+    if (animation.compressed.isValid()) {
+        CompressedFrame frame = animation.compressed.locateFrame(dt);
+        for (int i = 0; i < skeleton.size(); i++) {
+            int channel = animation.jointChannels[i];
+            if (jointHeights[i] < minHeight) {
+                skippedJoints++;
+            }
+            else if (channel != NO_CHANNEL) {
+                animation.compressed.gatherChannel(channel, frame, batch, i);
+            }
+            else {
+                batch.setIdentityKeys(i);
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < skeleton.size(); i++) {
+        int channel = animation.jointChannels[i];
+        if (jointHeights[i] < minHeight) {
+            skippedJoints++;
+        }
+        else if (channel != NO_CHANNEL) {
+            gatherChannel(animation.channels[channel], dt, cursors[i], batch, i);
+        }
+        else {
+            batch.setIdentityKeys(i);
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Model.h"
+#include "FrameArena.h"
+#include "AnimationLod.h"
+#include "PoseCache.h"
+
+const int ANIMATION_JOB_BATCH = 4;  // Characters evaluated by one pose job
+const int MAX_ADDITIVE_LAYERS = 4;
+const float DEFAULT_CROSS_FADE_DURATION = 0.2f;  // In the units of the update time step
+
+// A clip played on top of the base pose. Only its difference from its own first frame is added,
+// scaled by weight, so e.g. a breathing or flinch clip can run over any locomotion clip.
+struct AdditiveLayer
+{
+    const Animation* animation = nullptr;
+    float weight = 1.0f;
+    float time = 0.0f;
+    PoseSamplingBatch batch;                 // Keys of the layer clip, then its sampled pose in key slot 0
+    PoseSamplingBatch reference;             // First frame of the clip in key slot 0
+    std::vector<ChannelCursors> cursors = {};
+};
+
+// Playback state of one character.
+// The Model it plays holds the meshes, skeleton and clips and is only read here, so any number of
+// instances can animate the same loaded asset. Everything that changes from frame to frame lives in the instance.
+class AnimationInstance
+{
+public:
+    // A model still loading in the background is read once isReady(): the instance sizes its buffers on the first
+    // call after that, and plays nothing and ignores clip changes until then.
+    // modelLoading is for the thread loading the model, which may read it before it is ready, e.g. for its bounds.
+    AnimationInstance(const Model* model, bool modelLoading = false);
+
+    void applyPose(float timeStep);
+
+    // Switches clips, cross-fading from the current one over fadeDuration. A fade duration of 0 switches at once.
+    // Switching again during a fade fades out from the clip that was fading in.
+    // Switching to the clip already playing or to an unknown clip does nothing, unknown clips are reported at load.
+    void setActiveClip(ClipHandle clip);
+    void setActiveClip(ClipHandle clip, float fadeDuration);
+    void setActiveAnimation(AnimationState state);
+    void setActiveAnimation(AnimationState state, float fadeDuration);
+    // By name, for tools and tests. Looks the clip up on every call, gameplay code switches by state or handle.
+    void setActiveAnimation(const std::string& name);
+    void setActiveAnimation(const std::string& name, float fadeDuration);
+    void setCrossFadeDuration(float duration) {
+        crossFadeDuration = duration;
+    }
+
+    bool isCrossFading() const {
+        return fadeAnimation != nullptr;
+    }
+
+    // Clip fading out and its time, nullptr when not fading
+    const Animation* getFadeAnimation() const {
+        return fadeAnimation;
+    }
+
+    float getFadeAnimationTime() const {
+        return fadeAnimationTime;
+    }
+
+    // Plays a clip additively in one of MAX_ADDITIVE_LAYERS slots. Sets up the layer's buffers, so call it
+    // when the layer starts rather than every frame, and change the weight with setAdditiveLayerWeight.
+    bool setAdditiveLayer(int layer, ClipHandle clip, float weight = 1.0f);
+    bool setAdditiveLayer(int layer, const std::string& name, float weight = 1.0f);
+    void setAdditiveLayerWeight(int layer, float weight);
+    void clearAdditiveLayer(int layer);
+
+    void updatePrevTransforms();
+
+    // One fixed-step update at the given level of detail. Reduced-rate instances only evaluate a pose every
+    // lod.updateInterval updates and interpolate across the gap; off-screen instances only advance time.
+    void update(float timeStep, const AnimationLod& lod = AnimationLod());
+
+    const AnimationLodStats& getLastUpdateStats() const {
+        return lastUpdateStats;
+    }
+
+    // Opt-in: share evaluated poses with other instances of the same model through the cache.
+    // Clip time is then rounded to the cache's quantum. Pass nullptr to evaluate every pose again.
+    // Cross-faded and layered poses are always evaluated, they depend on more than one clip time.
+    void setPoseCache(PoseCache* cache);
+
+    // Palette interpolated between the last two evaluated poses, allocated from the frame arena
+    const glm::mat4* interpolateBoneTransformations(float alpha, FrameArena& arena) const;
+    void uploadBoneTransformations(Shader& shader, float alpha, FrameArena& arena);
+
+    // Evaluates a full pose of the given animation into output, indexed by bone ID
+    void getPose(const Animation& animation, float dt, std::vector<glm::mat4>& output, const glm::mat4& globalInverseTransform);
+
+    const Model* getModel() const {
+        return model;
+    }
+
+    const Animation* getActiveAnimation() const {
+        return currentAnimation;
+    }
+
+    ClipHandle getActiveClip() const {
+        return currentClip;
+    }
+
+    float getAnimationTime() const {
+        return currentAnimationTime;
+    }
+
+    const std::vector<glm::mat4>& getBoneTransforms() const {
+        return boneTransforms;
+    }
+
+private:
+    const Model* model;
+    bool modelBound = false;  // Buffers sized from the model's skeleton, see bindModel
+
+    const Animation* currentAnimation = nullptr;
+    ClipHandle currentClip = NO_CLIP;
+    float currentAnimationTime = 0.0f;
+
+    // Cross-fade state. Both clips are sampled every evaluation, blended per joint in local space,
+    // then composed once, all in buffers sized at construction.
+    const Animation* fadeAnimation = nullptr;   // Clip fading out, nullptr when not fading
+    float fadeAnimationTime = 0.0f;
+    float fadeElapsed = 0.0f;
+    float fadeDuration = 0.0f;
+    float crossFadeDuration = DEFAULT_CROSS_FADE_DURATION;
+    std::vector<ChannelCursors> fadeCursors;    // Per-joint keyframe cursors of the clip fading out
+    PoseSamplingBatch fadeBatch;                // Keys of the clip fading out
+    PoseSamplingBatch blendBatch;               // Sampled poses to blend in key slots 0 and 1, composed into the palette
+    AdditiveLayer additiveLayers[MAX_ADDITIVE_LAYERS];
+    int activeLayers = 0;
+    bool releasedBones = false;                 // Bones the last evaluation wrote may not be written by the next one
+
+    // Palettes of the last update and the one before, one matrix per bone ID.
+    // updatePrevTransforms swaps them, so bones the active clip never writes must hold the same value in both.
+    std::vector<glm::mat4> boneTransforms;
+    std::vector<glm::mat4> prevBoneTransforms;
+    std::vector<glm::mat4> globalTransforms;    // Per-joint scratch buffer for getPose
+    std::vector<ChannelCursors> keyframeCursors;  // Per-joint keyframe cursors of the active animation
+    PoseSamplingBatch poseBatch;                // One lane per joint
+    std::vector<int> jointHeights;              // Skeleton::computeJointHeights, for leaf joint skipping
+
+    // Level of detail state
+    int updateInterval = 1;           // Interval of the last evaluated pose, spreads the interpolation over it
+    int updatesSinceEvaluation = 0;
+    float pendingTime = 0.0f;         // Time of skipped updates, applied by the next evaluation
+    bool poseStale = false;           // Set while off-screen, the next evaluation does not interpolate from the old pose
+    int skippedJointLevels = 0;
+    bool leafKeysGathered = false;    // Skipped leaf lanes hold keys of the active clip
+    int skippedJoints = 0;            // Joints the last gatherPose left out
+    AnimationLodStats lastUpdateStats;
+
+    PoseCache* poseCache = nullptr;
+    bool poseFromCache = false;       // The last applyPose copied its palette from the cache
+    const glm::mat4 identityTransform = glm::mat4(1.0f);
+
+    bool bindModel(bool modelLoading = false);
+    void advanceTime(float timeStep);
+    void gatherPose(const Animation& animation, float dt, PoseSamplingBatch& batch, std::vector<ChannelCursors>& cursors, int minHeight);
+    int getLeafHeight(const Animation& animation);
+    void getBlendedPose(std::vector<glm::mat4>& output, const glm::mat4& globalInverseTransform);
+    void storePalette(const PoseSamplingBatch& batch, const Animation& animation, bool blended, std::vector<glm::mat4>& output, const glm::mat4& globalInverseTransform);
+    bool isJointBlended(int joint) const;
+    void freezeReleasedBones();
+};
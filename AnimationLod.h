@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+
+// Distances are in world units from the camera to the object's position
+struct AnimationLodSettings
+{
+    float reducedRateDistance = 20.0f;  // Beyond this the pose is evaluated every reducedRateInterval updates
+    int reducedRateInterval = 2;
+    float distantRateDistance = 50.0f;  // Beyond this, every distantRateInterval updates
+    int distantRateInterval = 4;
+    float leafJointDistance = 30.0f;    // Beyond this the last leafJointLevels joints of every chain keep their last sampled pose
+    int leafJointLevels = 1;
+    bool cullOffscreen = true;          // Objects outside the view frustum only advance time
+    float boundingRadius = 2.0f;        // Visibility sphere around the object's position, scaled by its largest Scale component, for models without bounds
+};
+
+// Level of detail of one instance for one update
+struct AnimationLod
+{
+    int updateInterval = 1;     // Evaluate the pose every Nth update, interpolating in between
+    int skippedJointLevels = 0; // Joints this close to the end of their chain are not resampled
+    bool visible = true;
+};
+
+// Per-update totals over every animated object, joint evaluations counted per skeleton joint
+struct AnimationLodStats
+{
+    int instances = 0;
+    int evaluated = 0;        // Instances whose pose was evaluated this update
+    int reducedRate = 0;      // Instances waiting for their next reduced-rate update
+    int offscreen = 0;        // Instances that only advanced time
+    int jointEvaluations = 0;
+    int jointEvaluationsSaved = 0;
+
+    void add(const AnimationLodStats& other)
+    {
+        instances += other.instances;
+        evaluated += other.evaluated;
+        reducedRate += other.reducedRate;
+        offscreen += other.offscreen;
+        jointEvaluations += other.jointEvaluations;
+        jointEvaluationsSaved += other.jointEvaluationsSaved;
+    }
+};
+
+inline AnimationLod chooseAnimationLod(const AnimationLodSettings& settings, float distance, bool visible)
+{
+    AnimationLod lod;
+    lod.visible = visible || !settings.cullOffscreen;
+    if (distance > settings.distantRateDistance) {
+        lod.updateInterval = std::max(settings.distantRateInterval, 1);
+    }
+    else if (distance > settings.reducedRateDistance) {
+        lod.updateInterval = std::max(settings.reducedRateInterval, 1);
+    }
+    lod.skippedJointLevels = distance > settings.leafJointDistance ? settings.leafJointLevels : 0;
+    return lod;
+}
+
+// View frustum planes, inward facing, extracted from a projection * view matrix
+struct ViewFrustum
+{
+    glm::vec4 planes[6];
+
+    explicit ViewFrustum(const glm::mat4& viewProjection)
+    {
+        for (int axis = 0; axis < 3; axis++) {
+            for (int side = 0; side < 2; side++) {
+                glm::vec4& plane = planes[axis * 2 + side];
+                for (int column = 0; column < 4; column++) {
+                    float row3 = viewProjection[column][3];
+                    float rowAxis = viewProjection[column][axis];
+                    plane[column] = side == 0 ? row3 + rowAxis : row3 - rowAxis;
+                }
+                plane /= glm::length(glm::vec3(plane));
+            }
+        }
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+
+    // False only when the box is entirely behind one plane, tested with the corner furthest along the plane normal
+    bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const
+    {
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+        }
+        return true;
+    }
+};
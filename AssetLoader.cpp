@@ -0,0 +1,76 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include "Model.h"
+
+AssetLoader::AssetLoader(int threadCount) : jobs(std::max(threadCount, 1))
+{
+
+}
+
+AssetLoader::~AssetLoader()
+{
+    jobs.wait(group);
+    for (Model* model : models) {
+        model->loader = nullptr;
+    }
+}
+
+void AssetLoader::enqueue(Model& model)
+{
+    models.push_back(&model);
+    model.loader = this;
+    model.loadJobs = &jobs;
+
+    Job job;
+    job.function = &AssetLoader::readModel;
+    job.data = &model;
+    jobs.submit(group, job);
+}
+
+void AssetLoader::cancel(Model& model)
+{
+    // Rare enough to simply wait for every model being read
+    jobs.wait(group);
+    models.erase(std::remove(models.begin(), models.end(), &model), models.end());
+    model.loader = nullptr;
+    model.discardPendingTextures();
+}
+
+void AssetLoader::readModel(void* data, int begin, int end)
+{
+    static_cast<Model*>(data)->readOnLoader();
+}
+
+void AssetLoader::update(float budgetMilliseconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float, std::milli>(budgetMilliseconds));
+    uploadReady(deadline);
+}
+
+void AssetLoader::finishAll()
+{
+    jobs.wait(group);
+    uploadReady(std::chrono::steady_clock::time_point::max());
+}
+
+void AssetLoader::uploadReady(std::chrono::steady_clock::time_point deadline)
+{
+    bool uploaded = false;
+    for (size_t i = 0; i < models.size();) {
+        Model& model = *models[i];
+        if (model.getLoadState() == MODEL_UPLOADING && (!uploaded || std::chrono::steady_clock::now() < deadline)) {
+            model.uploadPending(deadline);
+            uploaded = true;
+        }
+        ModelLoadState state = model.getLoadState();
+        if (state == MODEL_READY || state == MODEL_FAILED) {
+            model.loader = nullptr;
+            models.erase(models.begin() + i);
+            continue;
+        }
+        i++;
+    }
+}
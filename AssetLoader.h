@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include "JobSystem.h"
+
+const int DEFAULT_LOADER_THREADS = 2;
+const float DEFAULT_UPLOAD_BUDGET_MS = 2.0f;
+
+class Model;
+
+// Loads models in the background.
+// Loader threads read cooked models or import them, build their vertex and index arrays and decode their textures in
+// parallel. The GL thread uploads the results in update() under a per-frame time budget, so the game keeps rendering
+// while assets arrive and can watch each Model's load state and progress.
+class AssetLoader
+{
+public:
+    explicit AssetLoader(int threadCount = DEFAULT_LOADER_THREADS);
+    // Waits for the loader threads to finish the models they are reading
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Called by Model's asynchronous constructor and destructor
+    void enqueue(Model& model);
+    void cancel(Model& model);
+
+    // GL thread, once per frame: uploads what the loader threads have finished until the budget is spent.
+    // At least one texture or mesh is uploaded per call while any is waiting, so loading always progresses.
+    void update(float budgetMilliseconds = DEFAULT_UPLOAD_BUDGET_MS);
+
+    // Blocks until every enqueued model is ready or failed, helping the loader threads and uploading without a budget
+    void finishAll();
+
+    // Models enqueued and neither ready nor failed yet
+    int getPendingCount() const {
+        return static_cast<int>(models.size());
+    }
+
+private:
+    JobSystem jobs;
+    JobGroup group;
+    std::vector<Model*> models;
+
+    static void readModel(void* data, int begin, int end);
+    void uploadReady(std::chrono::steady_clock::time_point deadline);
+};
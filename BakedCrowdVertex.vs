@@ -0,0 +1,66 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 5) in ivec4 aBoneIDs;
+layout(location = 6) in vec4 aWeights;
+
+// Per instance, from CrowdBatch
+layout(location = 7) in mat4 aModel;      // Locations 7 to 10
+layout(location = 11) in vec4 aAnimation; // Clip index, time offset, playback speed
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float crowdTime;
+
+#define MAX_BAKED_CLIPS 32 // Same as MAX_BAKED_CLIPS in AnimationBaker.h
+
+// Filled by BakedAnimationTexture::bind
+uniform sampler2D bakedPalettes;              // One row per frame, three texels per bone: rows of the bone matrix
+uniform vec4 bakedClips[MAX_BAKED_CLIPS];     // First row, frame count, duration
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+void main()
+{
+    // Frame pair around this instance's clip time
+    vec4 clip = bakedClips[int(aAnimation.x)];
+    float duration = clip.z;
+    float time = duration > 0.0 ? mod(crowdTime * aAnimation.z + aAnimation.y, duration) : 0.0;
+    float frame = duration > 0.0 ? time / duration * (clip.y - 1.0) : 0.0;
+    int frame0 = int(floor(frame));
+    int frame1 = min(frame0 + 1, int(clip.y) - 1);
+    float alpha = frame - float(frame0);
+    int row0 = int(clip.x) + frame0;
+    int row1 = int(clip.x) + frame1;
+
+    // Blended rows of the bone matrix, identity when the vertex has no bones
+    vec4 rows[3] = vec4[3](vec4(1.0, 0.0, 0.0, 0.0), vec4(0.0, 1.0, 0.0, 0.0), vec4(0.0, 0.0, 1.0, 0.0));
+    if (aWeights[0] + aWeights[1] + aWeights[2] + aWeights[3] > 0.0) {
+        for (int r = 0; r < 3; r++) {
+            rows[r] = vec4(0.0);
+            for (int i = 0; i < 4; i++) {
+                int texel = aBoneIDs[i] * 3 + r;
+                vec4 row = mix(texelFetch(bakedPalettes, ivec2(texel, row0), 0), texelFetch(bakedPalettes, ivec2(texel, row1), 0), alpha);
+                rows[r] += row * aWeights[i];
+            }
+        }
+    }
+
+    vec4 position = vec4(aPos, 1.0);
+    vec4 transformedPos = vec4(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position), 1.0);
+    gl_Position = projection * view * aModel * transformedPos;
+
+    // Pass texture coordinates
+    TexCoords = aTexCoords;
+
+    // The rows as columns form the transposed bone matrix, so its inverse is the normal matrix
+    mat3 boneNormalMatrix = inverse(mat3(rows[0].xyz, rows[1].xyz, rows[2].xyz));
+    Normal = mat3(transpose(inverse(aModel))) * (boneNormalMatrix * aNormal);
+
+    // Pass transformed fragment position
+    FragPos = vec3(aModel * transformedPos);
+}
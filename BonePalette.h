@@ -0,0 +1,127 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "OpenGlErrors.h"
+#include "DualQuaternion.h"
+
+// Capacity of the bone palette. vertex.vs declares the same MAX_BONES, change both together.
+const int MAX_BONES = 100;
+const GLuint BONE_PALETTE_BINDING = 0;  // Uniform buffer binding point of the BonePalette block
+
+// Uploads skinning matrices with one call per draw.
+// Programs that declare the BonePalette uniform block read a shared uniform buffer, which is refilled with a
+// single buffer update. Programs that still declare a plain bones[] array get one glUniformMatrix4fv with a count.
+// When the block holds boneDualQuaternions instead of bones, the matrices are converted to dual quaternions first,
+// which halves the upload. Everything per program is looked up the first time the program is seen.
+class BonePalette
+{
+public:
+    void upload(GLuint program, const glm::mat4* transforms, int count)
+    {
+        const ProgramBinding& binding = bindProgram(program);
+
+        if (binding.usesBlock) {
+            const void* data = transforms;
+            size_t boneSize = sizeof(glm::mat4);
+            if (binding.dualQuaternions) {
+                boneSize = sizeof(PackedDualQuaternion);
+                count = std::min(count, MAX_BONES);
+                for (int i = 0; i < count; i++) {
+                    dualQuaternions[i] = packDualQuaternion(toDualQuaternion(transforms[i]));
+                }
+                data = dualQuaternions;
+            }
+            int uploadCount = std::min(count, static_cast<int>(binding.blockSize / boneSize));
+
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            // Orphan the previous palette so the driver does not wait for draws still reading it
+            glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, uploadCount * boneSize, data);
+            glBindBufferBase(GL_UNIFORM_BUFFER, BONE_PALETTE_BINDING, buffer);
+        }
+        else if (binding.uniformLocation != -1) {
+            glUniformMatrix4fv(binding.uniformLocation, std::min(count, binding.capacity), GL_FALSE, &transforms[0][0][0]);
+        }
+    }
+
+    void release()
+    {
+        if (buffer) glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        programs.clear();
+    }
+
+private:
+    struct ProgramBinding
+    {
+        GLuint program = 0;
+        bool usesBlock = false;
+        bool dualQuaternions = false;  // The block holds two vec4 per bone instead of a mat4
+        GLint blockSize = 0;
+        GLint uniformLocation = -1;    // bones[0] of programs without the block
+        int capacity = 0;              // Bones the program declares room for
+    };
+
+    GLuint buffer = 0;
+    std::vector<ProgramBinding> programs;
+    PackedDualQuaternion dualQuaternions[MAX_BONES];  // Conversion scratch for dual quaternion programs
+
+    const ProgramBinding& bindProgram(GLuint program)
+    {
+        for (const ProgramBinding& binding : programs) {
+            if (binding.program == program) return binding;
+        }
+
+        ProgramBinding binding;
+        binding.program = program;
+        GLuint blockIndex = glGetUniformBlockIndex(program, "BonePalette");
+        if (blockIndex != GL_INVALID_INDEX) {
+            if (!buffer) {
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+                glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            }
+            glUniformBlockBinding(program, blockIndex, BONE_PALETTE_BINDING);
+
+            GLuint memberIndex;
+            const char* dualQuaternionName = "boneDualQuaternions[0]";
+            glGetUniformIndices(program, 1, &dualQuaternionName, &memberIndex);
+            binding.dualQuaternions = memberIndex != GL_INVALID_INDEX;
+
+            glGetActiveUniformBlockiv(program, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &binding.blockSize);
+            binding.usesBlock = true;
+            size_t boneSize = binding.dualQuaternions ? sizeof(PackedDualQuaternion) : sizeof(glm::mat4);
+            binding.capacity = std::min(static_cast<int>(binding.blockSize / boneSize), MAX_BONES);
+            if (binding.capacity < MAX_BONES) {
+                std::cout << "WARNING::BONE_PALETTE:: Program " << program << " has room for " << binding.capacity
+                    << " bones, MAX_BONES is " << MAX_BONES << "." << std::endl;
+            }
+        }
+        else {
+            binding.uniformLocation = glGetUniformLocation(program, "bones[0]");
+            GLint arraySize = 0;
+            if (binding.uniformLocation != -1) {
+                GLuint uniformIndex;
+                const char* name = "bones[0]";
+                glGetUniformIndices(program, 1, &name, &uniformIndex);
+                glGetActiveUniformsiv(program, 1, &uniformIndex, GL_UNIFORM_SIZE, &arraySize);
+            }
+            binding.capacity = std::min(static_cast<int>(arraySize), MAX_BONES);
+        }
+        OpenGLErrors::checkOpenGLError("BonePalette::bindProgram");
+
+        programs.push_back(binding);
+        return programs.back();
+    }
+};
+
+// Palette shared by every skinned draw, its buffer is created on the first upload
+inline BonePalette& sharedBonePalette()
+{
+    static BonePalette palette;
+    return palette;
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Skeleton.h"
+#include "PoseKernel.h"
+
+// Storage format of one packed track
+enum TrackFormat
+{
+    TRACK_CONSTANT,     // No per-frame data, the value lives in PackedTrack::constant
+    TRACK_QUANTIZED_8,  // Vector tracks only: 3 x 8 bit, range-quantized
+    TRACK_QUANTIZED_16, // Vectors: 3 x 16 bit range-quantized. Rotations: smallest-three in 48 bits
+    TRACK_RAW           // Full precision floats
+};
+
+struct PackedTrack
+{
+    TrackFormat format = TRACK_CONSTANT;
+    uint32_t frameOffset = 0;                   // Byte offset of this track inside one packed frame
+    glm::vec4 constant = glm::vec4(0.0f);       // xyz for vectors, xyzw for rotations
+    glm::vec3 rangeMin = glm::vec3(0.0f);       // Quantization range of vector tracks
+    glm::vec3 rangeExtent = glm::vec3(0.0f);
+};
+
+struct PackedChannel
+{
+    PackedTrack position;
+    PackedTrack rotation;
+    PackedTrack scale;
+};
+
+// Bytes one frame of a track occupies in the packed stream
+inline uint32_t packedTrackSize(TrackFormat format, bool isRotation)
+{
+    switch (format)
+    {
+    case TRACK_QUANTIZED_8:
+        return 3;
+    case TRACK_QUANTIZED_16:
+        return 6;
+    case TRACK_RAW:
+        return isRotation ? 16 : 12;
+    default:
+        return 0;
+    }
+}
+
+const float QUAT_COMPONENT_RANGE = 0.70710678f;  // Largest magnitude of the three smallest components of a unit quaternion
+
+// Smallest-three encoding: 2 bits for the index of the dropped component, 15 bits for each of the other three
+inline void packQuat48(const glm::quat& q, uint16_t out[3])
+{
+    float c[4] = { q.x, q.y, q.z, q.w };
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (std::fabs(c[i]) > std::fabs(c[largest])) largest = i;
+    }
+    // q and -q are the same rotation, flip so the dropped component is positive
+    float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+    uint64_t bits = static_cast<uint64_t>(largest);
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        float normalized = (c[i] * sign / QUAT_COMPONENT_RANGE + 1.0f) * 0.5f;
+        uint64_t quantized = static_cast<uint64_t>(std::min(std::max(normalized, 0.0f), 1.0f) * 32767.0f + 0.5f);
+        bits = (bits << 15) | quantized;
+    }
+
+    out[0] = static_cast<uint16_t>(bits >> 32);
+    out[1] = static_cast<uint16_t>(bits >> 16);
+    out[2] = static_cast<uint16_t>(bits);
+}
+
+inline glm::quat unpackQuat48(const uint16_t in[3])
+{
+    uint64_t bits = (static_cast<uint64_t>(in[0]) << 32) | (static_cast<uint64_t>(in[1]) << 16) | in[2];
+    int largest = static_cast<int>((bits >> 45) & 3);
+
+    float c[4];
+    float sumSquares = 0.0f;
+    for (int i = 3; i >= 0; i--) {
+        if (i == largest) continue;
+        float normalized = static_cast<float>(bits & 0x7FFF) / 32767.0f;
+        c[i] = (normalized * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+        sumSquares += c[i] * c[i];
+        bits >>= 15;
+    }
+    c[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSquares));
+
+    return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+inline void packVec3(const PackedTrack& track, const glm::vec3& value, uint8_t* out)
+{
+    if (track.format == TRACK_RAW) {
+        memcpy(out, &value[0], 12);
+        return;
+    }
+
+    float maxValue = track.format == TRACK_QUANTIZED_8 ? 255.0f : 65535.0f;
+    for (int i = 0; i < 3; i++) {
+        float normalized = track.rangeExtent[i] > 0.0f ? (value[i] - track.rangeMin[i]) / track.rangeExtent[i] : 0.0f;
+        uint32_t quantized = static_cast<uint32_t>(std::min(std::max(normalized, 0.0f), 1.0f) * maxValue + 0.5f);
+        if (track.format == TRACK_QUANTIZED_8) {
+            out[i] = static_cast<uint8_t>(quantized);
+        }
+        else {
+            uint16_t value16 = static_cast<uint16_t>(quantized);
+            memcpy(out + i * 2, &value16, 2);
+        }
+    }
+}
+
+inline glm::vec3 unpackVec3(const PackedTrack& track, const uint8_t* in)
+{
+    glm::vec3 value;
+    switch (track.format)
+    {
+    case TRACK_CONSTANT:
+        return glm::vec3(track.constant);
+    case TRACK_RAW:
+        memcpy(&value[0], in, 12);
+        return value;
+    case TRACK_QUANTIZED_8:
+        for (int i = 0; i < 3; i++) {
+            value[i] = track.rangeMin[i] + track.rangeExtent[i] * (in[i] / 255.0f);
+        }
+        return value;
+    default:
+        for (int i = 0; i < 3; i++) {
+            uint16_t value16;
+            memcpy(&value16, in + i * 2, 2);
+            value[i] = track.rangeMin[i] + track.rangeExtent[i] * (value16 / 65535.0f);
+        }
+        return value;
+    }
+}
+
+inline void packRotation(const PackedTrack& track, const glm::quat& value, uint8_t* out)
+{
+    if (track.format == TRACK_RAW) {
+        float raw[4] = { value.x, value.y, value.z, value.w };
+        memcpy(out, raw, 16);
+        return;
+    }
+
+    uint16_t packed[3];
+    packQuat48(value, packed);
+    memcpy(out, packed, 6);
+}
+
+inline glm::quat unpackRotation(const PackedTrack& track, const uint8_t* in)
+{
+    switch (track.format)
+    {
+    case TRACK_CONSTANT:
+        return glm::quat(track.constant.w, track.constant.x, track.constant.y, track.constant.z);
+    case TRACK_RAW:
+    {
+        float raw[4];
+        memcpy(raw, in, 16);
+        return glm::quat(raw[3], raw[0], raw[1], raw[2]);
+    }
+    default:
+    {
+        uint16_t packed[3];
+        memcpy(packed, in, 6);
+        return unpackQuat48(packed);
+    }
+    }
+}
+
+// Normalized lerp along the shortest arc, accurate enough between densely resampled frames
+inline glm::quat nlerp(const glm::quat& a, const glm::quat& b, float alpha)
+{
+    float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    glm::quat result(
+        a.w * (1.0f - alpha) + b.w * alpha * sign,
+        a.x * (1.0f - alpha) + b.x * alpha * sign,
+        a.y * (1.0f - alpha) + b.y * alpha * sign,
+        a.z * (1.0f - alpha) + b.z * alpha * sign);
+    return glm::normalize(result);
+}
+
+// The two packed frames around a sample time, shared by every channel of the clip
+struct CompressedFrame
+{
+    const uint8_t* data0;
+    const uint8_t* data1;
+    float alpha;
+};
+
+// An animation resampled to a uniform frame rate and packed frame by frame.
+// Every frame stores the non-constant tracks of all channels back to back, so sampling one time
+// reads two contiguous blocks of the stream and needs no keyframe search.
+struct CompressedClip
+{
+    float startTime = 0.0f;
+    float frameInterval = 1.0f;     // Time between frames, in the same units as the source keyframe times
+    uint32_t frameCount = 0;
+    uint32_t frameStride = 0;       // Bytes per packed frame
+    std::vector<PackedChannel> channels = {};  // Same indices as Animation::channels
+    std::vector<uint8_t> frames = {};
+
+    bool isValid() const
+    {
+        return frameCount > 0;
+    }
+
+    size_t sizeInBytes() const
+    {
+        return sizeof(CompressedClip) + channels.size() * sizeof(PackedChannel) + frames.size();
+    }
+
+    CompressedFrame locateFrame(float time) const
+    {
+        float frame = std::max((time - startTime) / frameInterval, 0.0f);
+        uint32_t frame0 = std::min(static_cast<uint32_t>(frame), frameCount - 1);
+        uint32_t frame1 = std::min(frame0 + 1, frameCount - 1);
+
+        CompressedFrame located;
+        located.data0 = frames.data() + static_cast<size_t>(frame0) * frameStride;
+        located.data1 = frames.data() + static_cast<size_t>(frame1) * frameStride;
+        located.alpha = std::min(frame - static_cast<float>(frame0), 1.0f);
+        return located;
+    }
+
+    JointPose sampleChannel(int channel, float time) const
+    {
+        CompressedFrame frame = locateFrame(time);
+        const PackedChannel& packed = channels[channel];
+
+        JointPose pose;
+        pose.position = glm::mix(
+            unpackVec3(packed.position, frame.data0 + packed.position.frameOffset),
+            unpackVec3(packed.position, frame.data1 + packed.position.frameOffset), frame.alpha);
+        pose.rotation = nlerp(
+            unpackRotation(packed.rotation, frame.data0 + packed.rotation.frameOffset),
+            unpackRotation(packed.rotation, frame.data1 + packed.rotation.frameOffset), frame.alpha);
+        pose.scale = glm::mix(
+            unpackVec3(packed.scale, frame.data0 + packed.scale.frameOffset),
+            unpackVec3(packed.scale, frame.data1 + packed.scale.frameOffset), frame.alpha);
+        return pose;
+    }
+
+    // Decodes the two frames of one channel into a lane of the batch, the pose kernel interpolates them
+    void gatherChannel(int channel, const CompressedFrame& frame, PoseSamplingBatch& batch, int lane) const
+    {
+        const PackedChannel& packed = channels[channel];
+        batch.setPositionKeys(lane,
+            unpackVec3(packed.position, frame.data0 + packed.position.frameOffset),
+            unpackVec3(packed.position, frame.data1 + packed.position.frameOffset), frame.alpha);
+        batch.setRotationKeys(lane,
+            unpackRotation(packed.rotation, frame.data0 + packed.rotation.frameOffset),
+            unpackRotation(packed.rotation, frame.data1 + packed.rotation.frameOffset), frame.alpha);
+        batch.setScaleKeys(lane,
+            unpackVec3(packed.scale, frame.data0 + packed.scale.frameOffset),
+            unpackVec3(packed.scale, frame.data1 + packed.scale.frameOffset), frame.alpha);
+    }
+};
@@ -0,0 +1,82 @@
+#include "CrowdBatch.h"
+
+CrowdBatch::~CrowdBatch()
+{
+    release();
+}
+
+void CrowdBatch::setInstances(const Model& model, const std::vector<CrowdInstance>& instances)
+{
+    if (this->model != &model || vertexArrays.size() != model.meshes.size()) {
+        createVertexArrays(model);
+    }
+
+    instanceData.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        instanceData[i].model = instances[i].model;
+        instanceData[i].animation = glm::vec4(static_cast<float>(instances[i].clip), instances[i].timeOffset, instances[i].speed, 0.0f);
+    }
+    instanceCount = static_cast<int>(instances.size());
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(InstanceData), instanceData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    OpenGLErrors::checkOpenGLError("CrowdBatch::setInstances");
+}
+
+void CrowdBatch::Draw(Shader& shader, const BakedAnimationTexture& baked, float time, int textureUnit)
+{
+    if (!model || instanceCount == 0) return;
+
+    baked.bind(shader.ID, textureUnit);
+    shader.setFloat("crowdTime", time);
+    for (size_t i = 0; i < vertexArrays.size(); i++) {
+        model->meshes[i].Draw(shader, vertexArrays[i], instanceCount);
+    }
+}
+
+void CrowdBatch::release()
+{
+    if (!vertexArrays.empty()) {
+        glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+    }
+    if (instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+    vertexArrays.clear();
+    instanceBuffer = 0;
+    model = nullptr;
+    instanceCount = 0;
+}
+
+void CrowdBatch::createVertexArrays(const Model& model)
+{
+    release();
+    this->model = &model;
+    glGenBuffers(1, &instanceBuffer);
+    vertexArrays.resize(model.meshes.size());
+    glGenVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+
+    for (size_t i = 0; i < vertexArrays.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        glBindVertexArray(vertexArrays[i]);
+
+        // The mesh's own buffers, without the tangent frame the crowd shader does not read
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.getVertexBuffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.getElementBuffer());
+        setVertexAttributes(mesh.getVertexLayout(), vertexAttributeBit(0) | vertexAttributeBit(1) | vertexAttributeBit(2)
+            | vertexAttributeBit(5) | vertexAttributeBit(6));
+
+        // One model matrix and animation vector per instance
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(7 + column);
+            glVertexAttribPointer(7 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(7 + column, 1);
+        }
+        glEnableVertexAttribArray(11);
+        glVertexAttribPointer(11, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, animation));
+        glVertexAttribDivisor(11, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    OpenGLErrors::checkOpenGLError("CrowdBatch::createVertexArrays");
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Model.h"
+#include "AnimationBaker.h"
+
+// One character of a baked crowd. The clip plays from crowd time timeOffset at the given speed.
+struct CrowdInstance
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    int clip = 0;               // Index into BakedAnimationTexture::getClips
+    float timeOffset = 0.0f;
+    float speed = 1.0f;
+};
+
+// Draws many characters of one model with a single instanced draw per mesh, posed on the GPU from a
+// BakedAnimationTexture by BakedCrowdVertex.vs. The instances are only uploaded when they change.
+class CrowdBatch
+{
+public:
+    CrowdBatch() = default;
+    CrowdBatch(const CrowdBatch&) = delete;
+    CrowdBatch& operator=(const CrowdBatch&) = delete;
+    ~CrowdBatch();
+
+    void setInstances(const Model& model, const std::vector<CrowdInstance>& instances);
+    // The shader must be in use with its view and projection set
+    void Draw(Shader& shader, const BakedAnimationTexture& baked, float time, int textureUnit = 8);
+    void release();
+
+    int getInstanceCount() const {
+        return instanceCount;
+    }
+
+private:
+    // Per-instance vertex attributes, locations 7 to 11 of BakedCrowdVertex.vs
+    struct InstanceData
+    {
+        glm::mat4 model;
+        glm::vec4 animation;  // Clip, time offset, speed
+    };
+
+    const Model* model = nullptr;
+    std::vector<GLuint> vertexArrays;  // Mesh attributes plus the instance buffer, per mesh
+    GLuint instanceBuffer = 0;
+    std::vector<InstanceData> instanceData;
+    int instanceCount = 0;
+
+    void createVertexArrays(const Model& model);
+};
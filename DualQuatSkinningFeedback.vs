@@ -0,0 +1,52 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 5) in ivec4 aBoneIDs;
+layout(location = 6) in vec4 aWeights;
+
+#define MAX_BONES 100 // Same as MAX_BONES in BonePalette.h
+
+// Filled by BonePalette with one buffer update per draw, two entries per bone: real part, then dual part
+layout(std140) uniform BonePalette
+{
+    vec4 boneDualQuaternions[2 * MAX_BONES];
+};
+
+// Captured by transform feedback into the instance's pre-skinned buffer, in model space
+out vec3 SkinnedPosition;
+out vec3 SkinnedNormal;
+
+vec3 rotateVector(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    vec4 real = vec4(0.0, 0.0, 0.0, 1.0);
+    vec4 dual = vec4(0.0);
+
+    // Same blend as DualQuatVertex.vs
+    if (aWeights[0] + aWeights[1] + aWeights[2] + aWeights[3] > 0.0) {
+        vec4 pivot = boneDualQuaternions[2 * aBoneIDs[0]];
+        real = vec4(0.0);
+        for (int i = 0; i < 4; i++) {
+            vec4 boneReal = boneDualQuaternions[2 * aBoneIDs[i]];
+            vec4 boneDual = boneDualQuaternions[2 * aBoneIDs[i] + 1];
+            float weight = dot(pivot, boneReal) < 0.0 ? -aWeights[i] : aWeights[i];
+            real += boneReal * weight;
+            dual += boneDual * weight;
+        }
+        float len = length(real);
+        real /= len;
+        dual /= len;
+    }
+
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    SkinnedPosition = rotateVector(real, aPos) + translation;
+    SkinnedNormal = rotateVector(real, aNormal);
+
+    // Nothing is rasterized, the position is only written to keep the stage complete
+    gl_Position = vec4(SkinnedPosition, 1.0);
+}
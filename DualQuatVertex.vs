@@ -0,0 +1,66 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 3) in vec4 aTangent;   // w: bitangent sign, packed layouts encode the bitangent only through it
+layout(location = 4) in vec3 aBitangent; // Full vertex layout only. This shader reads neither tangent attribute.
+layout(location = 5) in ivec4 aBoneIDs;
+layout(location = 6) in vec4 aWeights;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+#define MAX_BONES 100 // Same as MAX_BONES in BonePalette.h
+
+// Filled by BonePalette with one buffer update per draw, two entries per bone: real part, then dual part
+layout(std140) uniform BonePalette
+{
+    vec4 boneDualQuaternions[2 * MAX_BONES];
+};
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+vec3 rotateVector(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    vec4 real = vec4(0.0, 0.0, 0.0, 1.0); // Identity when the vertex has no bones
+    vec4 dual = vec4(0.0);
+
+    if (aWeights[0] + aWeights[1] + aWeights[2] + aWeights[3] > 0.0) {
+        vec4 pivot = boneDualQuaternions[2 * aBoneIDs[0]];
+        real = vec4(0.0);
+        for (int i = 0; i < 4; i++) {
+            vec4 boneReal = boneDualQuaternions[2 * aBoneIDs[i]];
+            vec4 boneDual = boneDualQuaternions[2 * aBoneIDs[i] + 1];
+            // q and -q are the same rotation, blend every bone in the hemisphere of the first
+            float weight = dot(pivot, boneReal) < 0.0 ? -aWeights[i] : aWeights[i];
+            real += boneReal * weight;
+            dual += boneDual * weight;
+        }
+        float len = length(real);
+        real /= len;
+        dual /= len;
+    }
+
+    // Rotate, then add the translation 2 * dual * conjugate(real)
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    vec4 transformedPos = vec4(rotateVector(real, aPos) + translation, 1.0);
+    gl_Position = projection * view * model * transformedPos;
+
+    // Pass texture coordinates
+    TexCoords = aTexCoords;
+
+    // The blended transform is rigid, so normals only need its rotation. Assumes the object is scaled uniformly
+    Normal = mat3(model) * rotateVector(real, aNormal);
+
+    // Pass transformed fragment position
+    FragPos = vec3(model * transformedPos);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cmath>
+
+// How a model's vertices are blended between their bones
+enum SkinningMode
+{
+    LINEAR_BLEND_SKINNING,    // vertex.vs, blends bone matrices
+    DUAL_QUATERNION_SKINNING  // DualQuatVertex.vs, blends rigid transforms as dual quaternions
+};
+
+// Rigid transform as a unit dual quaternion: the rotation in real, half the translation times the rotation in dual
+struct DualQuaternion
+{
+    glm::quat real = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::quat dual = glm::quat(0.0f, 0.0f, 0.0f, 0.0f);
+};
+
+// Shader layout of one bone, two vec4 holding x, y, z, w of the real and the dual part
+struct PackedDualQuaternion
+{
+    glm::vec4 real;
+    glm::vec4 dual;
+};
+
+// Scale and shear cannot be expressed by a dual quaternion, only the rotation of the normalized axes is kept
+inline DualQuaternion toDualQuaternion(const glm::mat4& transform)
+{
+    glm::mat3 rotation(
+        glm::normalize(glm::vec3(transform[0])),
+        glm::normalize(glm::vec3(transform[1])),
+        glm::normalize(glm::vec3(transform[2])));
+    glm::vec3 translation(transform[3]);
+
+    DualQuaternion dq;
+    dq.real = glm::normalize(glm::quat_cast(rotation));
+    dq.dual = (glm::quat(0.0f, translation.x, translation.y, translation.z) * dq.real) * 0.5f;
+    return dq;
+}
+
+inline PackedDualQuaternion packDualQuaternion(const DualQuaternion& dq)
+{
+    PackedDualQuaternion packed;
+    packed.real = glm::vec4(dq.real.x, dq.real.y, dq.real.z, dq.real.w);
+    packed.dual = glm::vec4(dq.dual.x, dq.dual.y, dq.dual.z, dq.dual.w);
+    return packed;
+}
+
+inline glm::vec3 rotateVector(const glm::vec4& q, const glm::vec3& v)
+{
+    glm::vec3 axis(q);
+    return v + 2.0f * glm::cross(axis, glm::cross(axis, v) + q.w * v);
+}
+
+inline glm::vec3 transformPoint(const PackedDualQuaternion& dq, const glm::vec3& p)
+{
+    glm::vec3 real(dq.real);
+    glm::vec3 dual(dq.dual);
+    glm::vec3 translation = 2.0f * (dq.real.w * dual - dq.dual.w * real + glm::cross(real, dual));
+    return rotateVector(dq.real, p) + translation;
+}
+
+// Scalar CPU skinning of one vertex, the same math as vertex.vs and DualQuatVertex.vs.
+// Used as the reference when validating one skinning mode against the other.
+inline void skinVertexLinear(const glm::mat4* palette, const glm::ivec4& boneIDs, const glm::vec4& weights,
+    const glm::vec3& position, const glm::vec3& normal, glm::vec3& skinnedPosition, glm::vec3& skinnedNormal)
+{
+    glm::mat4 boneTransform(1.0f);
+    if (weights[0] + weights[1] + weights[2] + weights[3] > 0.0f) {
+        boneTransform = palette[boneIDs[0]] * weights[0];
+        for (int i = 1; i < 4; i++) {
+            boneTransform += palette[boneIDs[i]] * weights[i];
+        }
+    }
+    skinnedPosition = glm::vec3(boneTransform * glm::vec4(position, 1.0f));
+    skinnedNormal = glm::mat3(glm::transpose(glm::inverse(boneTransform))) * normal;
+}
+
+inline void skinVertexDualQuaternion(const PackedDualQuaternion* palette, const glm::ivec4& boneIDs, const glm::vec4& weights,
+    const glm::vec3& position, const glm::vec3& normal, glm::vec3& skinnedPosition, glm::vec3& skinnedNormal)
+{
+    PackedDualQuaternion blended;
+    blended.real = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    blended.dual = glm::vec4(0.0f);
+    if (weights[0] + weights[1] + weights[2] + weights[3] > 0.0f) {
+        const glm::vec4& pivot = palette[boneIDs[0]].real;
+        blended.real = glm::vec4(0.0f);
+        for (int i = 0; i < 4; i++) {
+            const PackedDualQuaternion& bone = palette[boneIDs[i]];
+            // q and -q are the same rotation, blend every bone in the hemisphere of the first
+            float weight = glm::dot(pivot, bone.real) < 0.0f ? -weights[i] : weights[i];
+            blended.real += bone.real * weight;
+            blended.dual += bone.dual * weight;
+        }
+        float length = glm::length(blended.real);
+        blended.real /= length;
+        blended.dual /= length;
+    }
+    skinnedPosition = transformPoint(blended, position);
+    skinnedNormal = rotateVector(blended.real, normal);
+}
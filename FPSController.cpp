@@ -19,7 +19,7 @@ void FPSController::Move(SDL_Event& event, GameObject* player, Camera& camera, b
     glm::vec3 moveDirection = glm::vec3(0.f);
 
     if (!isKeyDown) {
-        player->model->setActiveAnimation(getAnimationString(IDLE));
+        if (player->animation) player->animation->setActiveAnimation(IDLE);
         directionLocked = false; // Unlock the direction when no key is pressed
         return;
     }
@@ -62,6 +62,6 @@ void FPSController::Move(SDL_Event& event, GameObject* player, Camera& camera, b
         player->Position.y = terrainModel.getHeight(player->Position.x, player->Position.z);
 
         // Set walking animation
-        player->model->setActiveAnimation(getAnimationString(WALKING));
+        if (player->animation) player->animation->setActiveAnimation(WALKING);
     }
 }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+const size_t FRAME_ARENA_DEFAULT_CAPACITY = 256 * 1024;
+
+// Linear allocator for temporaries that live until the end of the frame.
+// Allocating bumps an offset and reset() releases everything at once; nothing is destroyed, so only trivially
+// destructible types may be allocated. A frame that needs more than the capacity takes the rest from overflow
+// blocks, and the next reset() grows the arena to that frame's high-water mark, so a warmed-up frame never
+// touches the heap.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = FRAME_ARENA_DEFAULT_CAPACITY) :
+        buffer(new unsigned char[capacity]), capacity(capacity)
+    {
+
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        return static_cast<T*>(allocateBytes(count * sizeof(T), alignof(T)));
+    }
+
+    // Releases every allocation of the frame
+    void reset()
+    {
+        if (!overflowBlocks.empty()) {
+            capacity = highWaterMark;
+            buffer.reset(new unsigned char[capacity]);
+            overflowBlocks.clear();
+            overflowBytes = 0;
+        }
+        offset = 0;
+    }
+
+    size_t getUsedBytes() const {
+        return offset + overflowBytes;
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    size_t getHighWaterMark() const {
+        return highWaterMark;
+    }
+
+private:
+    std::unique_ptr<unsigned char[]> buffer;
+    size_t capacity;
+    size_t offset = 0;
+    size_t overflowBytes = 0;
+    size_t highWaterMark = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> overflowBlocks;
+
+    void* allocateBytes(size_t size, size_t alignment)
+    {
+        uintptr_t base = reinterpret_cast<uintptr_t>(buffer.get());
+        size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (start + size <= capacity) {
+            offset = start + size;
+            highWaterMark = std::max(highWaterMark, getUsedBytes());
+            return buffer.get() + start;
+        }
+
+        // Out of room this frame, the block is folded into the arena on the next reset
+        size_t blockSize = size + alignment;
+        overflowBlocks.emplace_back(new unsigned char[blockSize]);
+        overflowBytes += blockSize;
+        highWaterMark = std::max(highWaterMark, getUsedBytes());
+        uintptr_t block = reinterpret_cast<uintptr_t>(overflowBlocks.back().get());
+        return reinterpret_cast<void*>((block + alignment - 1) & ~(alignment - 1));
+    }
+};
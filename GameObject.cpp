@@ -1,12 +1,39 @@
 #include "GameObject.h"
 
-void GameObject::DrawGameObject(Shader& shader, float alpha)
+void GameObject::DrawGameObject(Shader& shader, float alpha, FrameArena& frameArena)
 {
-    if (model)
+    // A model still loading draws the meshes uploaded so far, unless it needs its skeleton
+    if (model && (!animation || model->isReady()))
     {
         glm::mat4 modelMatrix = ComputeModelMatrix(Position, Rotation, Scale);
         shader.setMat4("model", modelMatrix);
-        model->Draw(shader, alpha);
+        if (animation)
+        {
+            animation->uploadBoneTransformations(shader, alpha, frameArena);
+        }
+        model->Draw(shader);
+    }
+}
+
+void GameObject::PreSkin(SkinningFeedback& feedback, float alpha, FrameArena& frameArena)
+{
+    if (preSkinned)
+    {
+        preSkinned->invalidate();
+    }
+    if (model && animation && preSkinned && model->isReady())
+    {
+        const glm::mat4* palette = animation->interpolateBoneTransformations(alpha, frameArena);
+        feedback.skin(*model, palette, static_cast<int>(animation->getBoneTransforms().size()), *preSkinned);
+    }
+}
+
+void GameObject::DrawPreSkinned(Shader& shader)
+{
+    if (model && preSkinned && model->isReady())
+    {
+        shader.setMat4("model", ComputeModelMatrix(Position, Rotation, Scale));
+        preSkinned->Draw(*model, shader);
     }
 }
 
@@ -41,4 +68,19 @@ glm::mat4 GameObject::ComputeModelMatrix(const glm::vec3& position, const glm::v
     modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.f, 1.f));
     modelMatrix = glm::scale(modelMatrix, scale);
     return modelMatrix;
-}
\ No newline at end of file
+}
+BoundingBox GameObject::GetWorldBounds()
+{
+    if (!model || !model->isReady()) return BoundingBox();
+
+    BoundingBox bounds = model->getBindBounds();
+    const Animation* clip = animation ? animation->getActiveAnimation() : nullptr;
+    if (clip && clip->bounds.isValid()) {
+        bounds = clip->bounds.getBounds(animation->getAnimationTime());
+        const Animation* fading = animation->getFadeAnimation();
+        if (fading && fading->bounds.isValid()) {
+            bounds.expand(fading->bounds.getBounds(animation->getFadeAnimationTime()));
+        }
+    }
+    return bounds.transformed(ComputeModelMatrix(Position, Rotation, Scale));
+}
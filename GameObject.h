@@ -3,6 +3,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Model.h"
+#include "AnimationInstance.h"
+#include "FrameArena.h"
+#include "SkinningFeedback.h"
 
 class GameObject
 {
@@ -12,9 +15,12 @@ public:
     glm::vec3 Scale;
     glm::vec3 Rotation;
     Model* model;
+    AnimationInstance* animation;  // Playback state of this object, the model itself may be shared
+    PreSkinnedBuffers* preSkinned;  // Optional, skinned once per frame and drawn as a static mesh by every pass
 
-    GameObject(std::string name, glm::vec3 pos, glm::vec3 scale, glm::vec3 rotation, Model* model) :
-       name(name), Position(pos), Rotation(rotation), Scale(scale), model(model)
+    GameObject(std::string name, glm::vec3 pos, glm::vec3 scale, glm::vec3 rotation, Model* model, AnimationInstance* animation = nullptr,
+       PreSkinnedBuffers* preSkinned = nullptr) :
+       name(name), Position(pos), Rotation(rotation), Scale(scale), model(model), animation(animation), preSkinned(preSkinned)
     {
 
     }
@@ -24,9 +30,15 @@ public:
 
     }
 
-    void DrawGameObject(Shader &shader, float alpha);
+    void DrawGameObject(Shader &shader, float alpha, FrameArena &frameArena);
+    void PreSkin(SkinningFeedback &feedback, float alpha, FrameArena &frameArena);
+    void DrawPreSkinned(Shader &shader);
     glm::vec3 GetForwardVector();
     glm::vec3 GetRightVector();
     glm::vec3 GetUpVector();
     glm::mat4 ComputeModelMatrix(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
+
+    // World-space box for culling. Animated objects use the bounds of the clip segment being played, joined with
+    // the clip fading out, other objects the bind pose. Additive layers are not included.
+    BoundingBox GetWorldBounds();
 };
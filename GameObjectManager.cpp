@@ -26,11 +26,186 @@ void GameObjectManager::RemoveGameObject(string name)
 
 void GameObjectManager::DrawAll(Shader &shader, float deltaTime)
 {
-	for (auto pair : gameObjects)
+	frameArena.reset();
+	for (auto& pair : gameObjects)
 	{
-		for (auto gameObject : pair.second)
+		for (auto& gameObject : pair.second)
 		{
-			gameObject.DrawGameObject(shader,deltaTime);
+			gameObject.DrawGameObject(shader, deltaTime, frameArena);
 		}
 	}
+}
+
+void GameObjectManager::DrawAll(Shader &shader, Shader &dualQuaternionShader, float deltaTime)
+{
+	frameArena.reset();
+
+	// One pass per skinning mode, so each shader is bound once
+	const SkinningMode modes[] = { LINEAR_BLEND_SKINNING, DUAL_QUATERNION_SKINNING };
+	Shader* shaders[] = { &shader, &dualQuaternionShader };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool bound = pass == 0;
+		for (auto& pair : gameObjects)
+		{
+			for (auto& gameObject : pair.second)
+			{
+				if (!gameObject.model || gameObject.model->getSkinningMode() != modes[pass]) continue;
+				if (!bound)
+				{
+					shaders[pass]->use();
+					bound = true;
+				}
+				gameObject.DrawGameObject(*shaders[pass], deltaTime, frameArena);
+			}
+		}
+		if (pass == 1 && bound)
+		{
+			shader.use();
+		}
+	}
+}
+
+void GameObjectManager::PreSkinAll(SkinningFeedback &feedback, float deltaTime)
+{
+	frameArena.reset();
+	feedback.begin();
+	for (auto& pair : gameObjects)
+	{
+		for (auto& gameObject : pair.second)
+		{
+			gameObject.PreSkin(feedback, deltaTime, frameArena);
+		}
+	}
+	feedback.end();
+}
+
+void GameObjectManager::DrawAllPreSkinned(Shader &shader, Shader &preSkinnedShader, float deltaTime)
+{
+	frameArena.reset();
+
+	// Static meshes first, then whatever still needs the skinning shader
+	bool bound = false;
+	for (auto& pair : gameObjects)
+	{
+		for (auto& gameObject : pair.second)
+		{
+			if (!gameObject.preSkinned || !gameObject.preSkinned->isSkinned()) continue;
+			if (!bound)
+			{
+				preSkinnedShader.use();
+				bound = true;
+			}
+			gameObject.DrawPreSkinned(preSkinnedShader);
+		}
+	}
+
+	shader.use();
+	for (auto& pair : gameObjects)
+	{
+		for (auto& gameObject : pair.second)
+		{
+			if (gameObject.preSkinned && gameObject.preSkinned->isSkinned()) continue;
+			gameObject.DrawGameObject(shader, deltaTime, frameArena);
+		}
+	}
+}
+
+void GameObjectManager::RequestTextureDetail(TextureStreamer &streamer, const glm::vec3 &cameraPosition, const glm::mat4 &view,
+	const glm::mat4 &projection, float viewportHeight)
+{
+	ViewFrustum frustum(projection * view);
+	for (auto& pair : gameObjects)
+	{
+		for (auto& gameObject : pair.second)
+		{
+			BoundingBox bounds = gameObject.GetWorldBounds();
+			if (!bounds.isValid() || !frustum.intersectsBox(bounds.min, bounds.max)) continue;
+
+			// Height of the bounding sphere on screen, projection[1][1] is 1 / tan(fovy / 2)
+			glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+			float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+			float distance = std::max(glm::length(center - cameraPosition), 0.001f);
+			float screenPixels = radius / distance * projection[1][1] * viewportHeight;
+			for (const Mesh& mesh : gameObject.model->meshes)
+			{
+				for (const Texture& texture : mesh.textures)
+				{
+					streamer.requestDetail(texture.id, screenPixels);
+				}
+			}
+		}
+	}
+}
+
+// Evaluates the pose of every animated object in parallel and returns once all palettes are ready to draw
+void GameObjectManager::UpdateAnimations(float timeStep, JobSystem &jobSystem)
+{
+	animatedInstances.clear();
+	animatedLods.clear();
+	for (auto& pair : gameObjects)
+	{
+		for (auto& gameObject : pair.second)
+		{
+			// Models still loading in the background are written by the loader threads, leave them until ready
+			if (gameObject.animation && gameObject.model && gameObject.model->isReady())
+			{
+				animatedInstances.push_back(gameObject.animation);
+				animatedLods.push_back(AnimationLod());
+			}
+		}
+	}
+	RunAnimationUpdates(timeStep, jobSystem);
+}
+
+void GameObjectManager::UpdateAnimations(float timeStep, JobSystem &jobSystem, const AnimationLodSettings &lodSettings,
+	const glm::vec3 &cameraPosition, const glm::mat4 &viewProjection)
+{
+	ViewFrustum frustum(viewProjection);
+	animatedInstances.clear();
+	animatedLods.clear();
+	for (auto& pair : gameObjects)
+	{
+		for (auto& gameObject : pair.second)
+		{
+			if (gameObject.animation && gameObject.model && gameObject.model->isReady())
+			{
+				bool visible;
+				BoundingBox bounds = gameObject.GetWorldBounds();
+				if (bounds.isValid())
+				{
+					visible = frustum.intersectsBox(bounds.min, bounds.max);
+				}
+				else
+				{
+					const glm::vec3& scale = gameObject.Scale;
+					float radius = lodSettings.boundingRadius * std::max(std::max(std::fabs(scale.x), std::fabs(scale.y)), std::fabs(scale.z));
+					visible = frustum.intersectsSphere(gameObject.Position, radius);
+				}
+				float distance = glm::length(gameObject.Position - cameraPosition);
+				animatedInstances.push_back(gameObject.animation);
+				animatedLods.push_back(chooseAnimationLod(lodSettings, distance, visible));
+			}
+		}
+	}
+	RunAnimationUpdates(timeStep, jobSystem);
+}
+
+void GameObjectManager::RunAnimationUpdates(float timeStep, JobSystem &jobSystem)
+{
+	// Each job only writes the instances it was given, the shared models are read-only
+	auto update = [&](int i)
+	{
+		animatedInstances[i]->update(timeStep, animatedLods[i]);
+	};
+
+	JobGroup group;
+	jobSystem.parallelFor(group, static_cast<int>(animatedInstances.size()), ANIMATION_JOB_BATCH, update);
+	jobSystem.wait(group);
+
+	animationLodStats = AnimationLodStats();
+	for (AnimationInstance* instance : animatedInstances)
+	{
+		animationLodStats.add(instance->getLastUpdateStats());
+	}
 }
\ No newline at end of file
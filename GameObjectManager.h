@@ -3,6 +3,10 @@
 #include <map>
 #include <iostream>
 #include "GameObject.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "AnimationLod.h"
+#include "TextureStreamer.h"
 #include <vector>
 
 class GameObjectManager
@@ -13,10 +17,40 @@ public:
 	~GameObjectManager();
 
 	std::map<string, std::vector<GameObject>> gameObjects;
+	FrameArena frameArena;  // Per-frame temporaries of DrawAll, reset at the start of every DrawAll
 	
 	void AddGameObject(string name, GameObject gameObject);
 	void RemoveGameObject(string name);
 	void DrawAll(Shader &shader, float deltaTime);
+	// Draws models set to DUAL_QUATERNION_SKINNING with dualQuaternionShader and everything else with shader.
+	// Both need their view, projection and lighting uniforms set; shader is left in use.
+	void DrawAll(Shader &shader, Shader &dualQuaternionShader, float deltaTime);
+	void UpdateAnimations(float timeStep, JobSystem &jobSystem);
+	// Same with animation LOD: update rate and leaf joint skipping follow the distance to the camera,
+	// objects outside the view frustum only advance time
+	void UpdateAnimations(float timeStep, JobSystem &jobSystem, const AnimationLodSettings &lodSettings,
+		const glm::vec3 &cameraPosition, const glm::mat4 &viewProjection);
+	// Totals of the last UpdateAnimations, including how many joint evaluations LOD saved
+	const AnimationLodStats& GetAnimationLodStats() const { return animationLodStats; }
+	// Skins every animated object that has pre-skinned buffers, once per frame before the first pass. Must run every
+	// frame DrawAllPreSkinned is used: objects it does not skin again fall back to the skinning shader, but a frame
+	// without it draws last frame's vertices. Resets the frame arena like DrawAll.
+	void PreSkinAll(SkinningFeedback &feedback, float deltaTime);
+	// Draws one pass. Objects pre-skinned this frame are drawn as static meshes with preSkinnedShader,
+	// everything else with shader. Both need their view, projection and lighting uniforms set; shader is left in use.
+	void DrawAllPreSkinned(Shader &shader, Shader &preSkinnedShader, float deltaTime);
+	// Asks the streamer for the texture detail of every visible object from the height its bounds cover on screen.
+	// Call once per frame before streamer.update().
+	void RequestTextureDetail(TextureStreamer &streamer, const glm::vec3 &cameraPosition, const glm::mat4 &view,
+		const glm::mat4 &projection, float viewportHeight);
+
+private:
+
+	std::vector<AnimationInstance*> animatedInstances;  // Reused every update so it only allocates while the scene grows
+	std::vector<AnimationLod> animatedLods;             // Level of detail of each entry in animatedInstances
+	AnimationLodStats animationLodStats;
+
+	void RunAnimationUpdates(float timeStep, JobSystem &jobSystem);
 
 };
 
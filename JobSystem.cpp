@@ -0,0 +1,145 @@
+#include "JobSystem.h"
+
+namespace
+{
+    // Queue owned by the current thread, only meaningful while owner is the system asking
+    thread_local const JobSystem* currentOwner = nullptr;
+    thread_local int currentQueueIndex = 0;
+}
+
+JobQueue::JobQueue() : jobs(JOB_QUEUE_CAPACITY)
+{
+
+}
+
+bool JobQueue::push(const Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == jobs.size()) return false;
+    jobs[(head + count) % jobs.size()] = job;
+    count++;
+    return true;
+}
+
+bool JobQueue::pop(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) return false;
+    count--;
+    job = jobs[(head + count) % jobs.size()];
+    return true;
+}
+
+bool JobQueue::steal(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) return false;
+    job = jobs[head];
+    head = (head + 1) % jobs.size();
+    count--;
+    return true;
+}
+
+JobSystem::JobSystem(int workerCount)
+{
+    workerCount = std::max(workerCount, 0);
+    for (int i = 0; i <= workerCount; i++) {
+        queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+    }
+    for (int i = 1; i <= workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int JobSystem::defaultWorkerCount()
+{
+    int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(hardwareThreads - 1, 0);
+}
+
+void JobSystem::submit(JobGroup& group, const Job& job)
+{
+    Job grouped = job;
+    grouped.group = &group;
+    enqueue(grouped);
+    wakeWorkers();
+}
+
+void JobSystem::enqueue(const Job& job)
+{
+    job.group->pending.fetch_add(1, std::memory_order_relaxed);
+    if (!queues[currentQueue()]->push(job)) {
+        execute(job);  // Queue full, run it right away rather than grow
+        return;
+    }
+    queuedJobs.fetch_add(1, std::memory_order_release);
+}
+
+void JobSystem::wakeWorkers()
+{
+    if (workers.empty()) return;
+    // Taking the lock orders this wake after a worker's last check of queuedJobs, so it cannot be missed
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wakeCondition.notify_all();
+}
+
+void JobSystem::wait(JobGroup& group)
+{
+    int queueIndex = currentQueue();
+    while (group.pending.load(std::memory_order_acquire) > 0) {
+        if (!runOneJob(queueIndex)) {
+            std::this_thread::yield();  // The remaining jobs are running on other threads
+        }
+    }
+}
+
+bool JobSystem::runOneJob(int queueIndex)
+{
+    Job job;
+    bool found = queues[queueIndex]->pop(job);
+    for (size_t i = 1; !found && i < queues.size(); i++) {
+        found = queues[(queueIndex + i) % queues.size()]->steal(job);
+    }
+    if (!found) return false;
+
+    queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(const Job& job)
+{
+    job.function(job.data, job.begin, job.end);
+    job.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop(int queueIndex)
+{
+    currentOwner = this;
+    currentQueueIndex = queueIndex;
+
+    while (true) {
+        if (runOneJob(queueIndex)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeCondition.wait(lock, [&]() { return !running || queuedJobs.load(std::memory_order_acquire) > 0; });
+        if (!running) return;
+    }
+}
+
+int JobSystem::currentQueue() const
+{
+    return currentOwner == this ? currentQueueIndex : 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs of one batch, JobSystem::wait on it to join
+struct JobGroup
+{
+    std::atomic<int> pending{ 0 };
+};
+
+// A range of work items run by one call of function
+struct Job
+{
+    void (*function)(void* data, int begin, int end) = nullptr;
+    void* data = nullptr;
+    int begin = 0;
+    int end = 0;
+    JobGroup* group = nullptr;
+};
+
+const int JOB_QUEUE_CAPACITY = 4096;
+
+// Fixed-size double-ended job queue, never allocates after construction.
+// The owning thread pushes and pops at the back, other threads steal the oldest jobs from the front.
+class JobQueue
+{
+public:
+    JobQueue();
+
+    bool push(const Job& job);  // False when full
+    bool pop(Job& job);
+    bool steal(Job& job);
+
+private:
+    std::mutex mutex;
+    std::vector<Job> jobs;
+    size_t head = 0;  // Oldest job
+    size_t count = 0;
+};
+
+// Work-stealing thread pool.
+// The thread that creates the system owns queue 0 and works on it while it waits, every worker owns one more queue
+// and steals from the others when its own runs dry.
+class JobSystem
+{
+public:
+    JobSystem(int workerCount = defaultWorkerCount());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // One less than the hardware threads, the calling thread is the last one
+    static int defaultWorkerCount();
+
+    int getThreadCount() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    void submit(JobGroup& group, const Job& job);
+
+    // Splits [0, count) into jobs of grainSize items and calls fn(i) for each item.
+    // fn is referenced by the jobs, so it must stay alive until wait(group) returns.
+    template <typename Fn>
+    void parallelFor(JobGroup& group, int count, int grainSize, Fn& fn)
+    {
+        Job job;
+        job.function = &runRange<Fn>;
+        job.data = &fn;
+        job.group = &group;
+        for (int begin = 0; begin < count; begin += grainSize) {
+            job.begin = begin;
+            job.end = std::min(begin + grainSize, count);
+            enqueue(job);
+        }
+        wakeWorkers();
+    }
+
+    // Runs queued jobs on the calling thread until every job of the group has finished
+    void wait(JobGroup& group);
+
+private:
+    std::vector<std::unique_ptr<JobQueue>> queues;  // queues[0] belongs to the creating thread, queues[i] to workers[i - 1]
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<int> queuedJobs{ 0 };
+    bool running = true;  // Guarded by sleepMutex
+
+    template <typename Fn>
+    static void runRange(void* data, int begin, int end)
+    {
+        Fn& fn = *static_cast<Fn*>(data);
+        for (int i = begin; i < end; i++) {
+            fn(i);
+        }
+    }
+
+    void enqueue(const Job& job);
+    void wakeWorkers();
+    bool runOneJob(int queueIndex);
+    void execute(const Job& job);
+    void workerLoop(int queueIndex);
+    int currentQueue() const;
+};
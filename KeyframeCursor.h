@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Remembers which keyframe interval a track was sampled in last frame.
+// During normal playback time only moves forward by a fraction of a key, so the next lookup
+// resumes from here in O(1). Jumps (wrap, seek, clip switch) fall back to a binary search.
+struct KeyframeCursor
+{
+    unsigned int frame = 1;  // Index of the upper key of the last interval, always >= 1
+};
+
+// Per-channel cursors for the three tracks of a BoneTransformTrack
+struct ChannelCursors
+{
+    KeyframeCursor position;
+    KeyframeCursor rotation;
+    KeyframeCursor scale;
+};
+
+// How many keys the cursor may step forward before a binary search becomes cheaper
+const unsigned int MAX_CURSOR_STEPS = 4;
+
+// Returns { frame, fraction } so that the sample lies between keys frame - 1 and frame.
+// Tracks with fewer than two keys return { 0, 0 }; the caller samples key 0 directly.
+inline std::pair<unsigned int, float> findKeyframe(const std::vector<float>& times, float time, KeyframeCursor& cursor)
+{
+    const unsigned int count = static_cast<unsigned int>(times.size());
+    if (count < 2) {
+        return { 0, 0.0f };
+    }
+
+    const unsigned int lastFrame = count - 1;
+    unsigned int frame = cursor.frame;
+
+    if (frame < 1 || frame > lastFrame || (frame > 1 && time < times[frame - 1])) {
+        // Time went backwards or the cursor belongs to another track, search the whole track
+        frame = 0;
+    }
+    else {
+        // Playback moves forward, step from the previous interval
+        unsigned int steps = 0;
+        while (frame < lastFrame && time >= times[frame] && steps < MAX_CURSOR_STEPS) {
+            frame++;
+            steps++;
+        }
+        if (frame < lastFrame && time >= times[frame]) {
+            frame = 0;  // Large forward jump
+        }
+    }
+
+    if (frame == 0) {
+        // First key after time, ignoring key 0 so the interval never underflows
+        frame = static_cast<unsigned int>(std::upper_bound(times.begin() + 1, times.end(), time) - times.begin());
+        frame = std::min(frame, lastFrame);
+    }
+
+    cursor.frame = frame;
+
+    float lastTime = times[frame - 1];
+    float nextTime = times[frame];
+    float fraction = (time - lastTime) / (nextTime - lastTime);
+
+    return { frame, fraction };
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. The bytes stay valid until close() or destruction.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const {
+        return data != nullptr;
+    }
+
+    const uint8_t* getData() const {
+        return data;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int file = -1;
+#endif
+};
+
+// Size and modification time of a file, for cache staleness checks. False if the file does not exist.
+bool getFileStamp(const std::string& path, uint64_t& size, int64_t& modifiedTime);
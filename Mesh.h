@@ -5,48 +5,109 @@
 #include "glad/glad.h"
 #include "Shader.h"
 #include <string>
+#include <utility>
 #include <vector>
 #include "OpenGlErrors.h"
+#include "VertexFormat.h"
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    glm::vec3 Tangent;
-    glm::vec3 Bitangent;
-    glm::ivec4 BoneIDs = glm::ivec4(0); // Initialize to zero
-    glm::vec4 Weights = glm::vec4(0.0f); // Initialize to zero
-};
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// Geometry and texture references of a mesh before it is uploaded, built without a GL context
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<Texture> textures;  // Type and path only, ids are assigned on upload
+};
+
+// How much of its CPU geometry a mesh keeps once the buffers are uploaded, see Mesh::releaseGeometry
+enum MeshGeometryRetention
+{
+    KEEP_FULL_GEOMETRY,       // Every Vertex and index, for CPU skinning, benchmarks and re-cooking
+    KEEP_COLLISION_GEOMETRY,  // Positions and indices only, for collision and height queries
+    KEEP_NO_GEOMETRY
+};
+
+// Owns its vertex array and buffers, which are deleted with it. Move-only, so the GL objects always have exactly one owner.
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, the CPU copy may be dropped after upload with releaseGeometry
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
-    unsigned int VAO;
+    unsigned int VAO = 0;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // Takes over the arrays the loader built, they are moved in rather than copied
+    Mesh(vector<Vertex>&& vertices, vector<unsigned int>&& indices, vector<Texture>&& textures)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // Uploads the buffers straight from memory the caller owns, such as a mapped cooked model, before copying them.
+    // The CPU copy is kept for bounds, CPU skinning and terrain height queries.
+    Mesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, vector<Texture>&& textures)
+        : textures(std::move(textures))
+    {
+        setupMesh(vertices, vertexCount, indices, indexCount);
+        this->vertices.assign(vertices, vertices + vertexCount);
+        this->indices.assign(indices, indices + indexCount);
+    }
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Moves leave the source without GL objects, so only the new owner deletes them
+    Mesh(Mesh&& other) noexcept
+        : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)),
+        VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), vertexLayout(other.vertexLayout), indexType(other.indexType),
+        vertexCount(other.vertexCount), indexCount(other.indexCount), positions(std::move(other.positions))
+    {
+        other.VAO = 0;
+        other.VBO = 0;
+        other.EBO = 0;
+    }
+
+    Mesh& operator=(Mesh&& other) noexcept
+    {
+        if (this != &other) {
+            deleteBuffers();
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = std::move(other.textures);
+            positions = std::move(other.positions);
+            VAO = other.VAO;
+            VBO = other.VBO;
+            EBO = other.EBO;
+            vertexLayout = other.vertexLayout;
+            indexType = other.indexType;
+            vertexCount = other.vertexCount;
+            indexCount = other.indexCount;
+            other.VAO = 0;
+            other.VBO = 0;
+            other.EBO = 0;
+        }
+        return *this;
+    }
+
+    // Needs the GL context the mesh was uploaded with to still be current
+    ~Mesh()
+    {
+        deleteBuffers();
     }
 
     void Draw(Shader& shader) {
+        Draw(shader, VAO);
+    }
+
+    // Draws the mesh's indices and textures from another vertex array, such as one holding pre-skinned vertices
+    // or per-instance attributes. More than one instance draws instanced.
+    void Draw(Shader& shader, unsigned int vertexArray, int instanceCount = 1) const {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
@@ -57,7 +118,7 @@ public:
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
 
             // Find the correct uniform index
-            string name = textures[i].type;
+            const string& name = textures[i].type;
             int index = 0;
             if (name == "texture_diffuse") {
                 index = diffuseNr++;
@@ -76,20 +137,88 @@ public:
             glUniform1i(glGetUniformLocation(shader.ID, "textures[0]"), i);
         }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        OpenGLErrors::checkOpenGLError("glDrawElements");
+        glBindVertexArray(vertexArray);
+        if (!hasSkinStreams()) {
+            clearSkinAttributes();
+        }
+        if (instanceCount > 1) {
+            glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indexCount), indexType, 0, instanceCount);
+            OpenGLErrors::checkOpenGLError("glDrawElementsInstanced");
+        }
+        else {
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexCount), indexType, 0);
+            OpenGLErrors::checkOpenGLError("glDrawElements");
+        }
         glBindVertexArray(0);
         glActiveTexture(GL_TEXTURE0);
     }
 
+    unsigned int getVertexBuffer() const { return VBO; }
+    unsigned int getElementBuffer() const { return EBO; }
+    VertexLayout getVertexLayout() const { return vertexLayout; }
+    // Static packed meshes have no bone indices or weights, see clearSkinAttributes
+    bool hasSkinStreams() const { return vertexLayout != VERTEX_PACKED_STATIC; }
+    size_t getVertexCount() const { return vertexCount; }
+    size_t getIndexCount() const { return indexCount; }
+    GLenum getIndexType() const { return indexType; }
+    size_t getVertexBufferBytes() const { return vertexCount * getVertexStride(vertexLayout); }
+    size_t getIndexBufferBytes() const { return indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t)); }
+
+    // Whether every Vertex is still on the CPU, as CPU skinning, the benchmarks and ModelCache::write need
+    bool hasFullGeometry() const { return vertices.size() == vertexCount; }
+
+    // Bind-pose vertex positions, from the full vertices or from the collision copy releaseGeometry kept.
+    // 0 once the geometry is released without KEEP_COLLISION_GEOMETRY.
+    size_t getPositionCount() const { return vertices.empty() ? positions.size() : vertices.size(); }
+    const glm::vec3& getPosition(size_t i) const { return vertices.empty() ? positions[i] : vertices[i].Position; }
+
+    // Frees the CPU copy of the geometry once the buffers are uploaded. Drawing does not need it.
+    void releaseGeometry(MeshGeometryRetention retention)
+    {
+        if (retention == KEEP_FULL_GEOMETRY) return;
+        if (retention == KEEP_COLLISION_GEOMETRY && !vertices.empty()) {
+            positions.resize(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++) {
+                positions[i] = vertices[i].Position;
+            }
+        }
+        if (retention == KEEP_NO_GEOMETRY) {
+            vector<glm::vec3>().swap(positions);
+            vector<unsigned int>().swap(indices);
+        }
+        vector<Vertex>().swap(vertices);
+    }
+
+    // Bytes of CPU geometry the mesh still holds
+    size_t getCpuGeometryBytes() const {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) + positions.capacity() * sizeof(glm::vec3);
+    }
+
 private:
     // render data 
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+    VertexLayout vertexLayout = VERTEX_FULL;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    vector<glm::vec3> positions;  // Collision copy of the positions once vertices are released
+
+    void deleteBuffers()
+    {
+        if (VAO) glDeleteVertexArrays(1, &VAO);
+        if (VBO) glDeleteBuffers(1, &VBO);
+        if (EBO) glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // initializes all the buffer objects/arrays, in the most compact vertex layout and index size the mesh allows
+    void setupMesh(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount)
     {
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        vertexLayout = chooseVertexLayout(vertexData, vertexCount);
+        indexType = vertexCount <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
@@ -98,38 +227,26 @@ private:
         OpenGLErrors::checkOpenGLError("glBindVertexArray");
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         OpenGLErrors::checkOpenGLError("glBindBuffer");
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        if (vertexLayout == VERTEX_FULL) {
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+        }
+        else {
+            vector<uint8_t> packed;
+            packVertices(vertexData, vertexCount, vertexLayout, packed);
+            glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+        }
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // Vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-
-        // Vertex Normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-
-        // Texture Coordinates
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-        // Tangents
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-
-        // Bitangents
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        // Bone IDs
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, BoneIDs));
+        if (indexType == GL_UNSIGNED_SHORT) {
+            vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        }
 
-        // Weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
+        // Positions, normals, texture coordinates, tangents, bitangents (full layout only), bone IDs and weights
+        setVertexAttributes(vertexLayout);
 
         glBindVertexArray(0);
     }
@@ -10,16 +10,30 @@
 #include "Shader.h"
 #include <SDL.h>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <unordered_map>
 #include <vector>
 #include "TextureUtility.h"
+#include "TextureCache.h"
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "AnimationEnum.h"
+#include "Skeleton.h"
+#include "KeyframeCursor.h"
+#include "Animation.h"
+#include "AnimationCompressor.h"
+#include "BonePalette.h"
+#include "DualQuaternion.h"
+#include "ModelCache.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
 
 #ifndef uint
 typedef unsigned int uint;
@@ -36,11 +50,13 @@ inline glm::quat assimpToGlmQuat(const aiQuaternion& quat) {
     return glm::quat(quat.w, quat.x, quat.y, quat.z);
 }
 
+inline void updateBoneTransformations(Shader& shader, const glm::mat4* boneTransforms, int count) {
+    if (count == 0) return;
+    sharedBonePalette().upload(shader.ID, boneTransforms, count);
+}
+
 inline void updateBoneTransformations(Shader& shader, const vector<glm::mat4>& boneTransforms) {
-    for (unsigned int i = 0; i < boneTransforms.size(); i++) {
-        std::string name = "bones[" + std::to_string(i) + "]";
-        shader.setMat4(name.c_str(), boneTransforms[i]);
-    }
+    updateBoneTransformations(shader, boneTransforms.data(), static_cast<int>(boneTransforms.size()));
 }
 
 inline glm::mat4 lerp(const glm::mat4& a, const glm::mat4& b, float alpha) {
@@ -56,117 +72,280 @@ struct BoneInfo {
     glm::mat4 finalTransformation;
 };
 
-struct Bone {
-    int id = 0;
-    string name = "";
-    glm::mat4 offset = glm::mat4(1.0f);
-    vector<Bone> children = {};
-};
-
-struct BoneTransformTrack {
-    vector<float> positionTimestamps = {};
-    vector<float> rotationTimestamps = {};
-    vector<float> scaleTimestamps = {};
-
-    vector<glm::vec3> positions = {};
-    vector<glm::quat> rotations = {};
-    vector<glm::vec3> scales = {};
+enum ModelLoadState
+{
+    MODEL_LOADING,    // Being read or imported on a loader thread
+    MODEL_UPLOADING,  // Meshes built and textures decoded, uploaded by AssetLoader::update
+    MODEL_READY,
+    MODEL_FAILED
 };
 
-struct Animation {
-    float duration = 0.0f;
-    float ticksPerSecond = 1.0f;
-    bool active = true;  // Flag to determine if the animation should be updated
-    unordered_map<string, BoneTransformTrack> boneTransforms = {};
+// What one model holds in memory, see Model::getMemoryStats
+struct ModelMemoryStats
+{
+    int meshCount = 0;
+    size_t cpuGeometryBytes = 0;  // Vertices, indices and collision positions still on the CPU
+    size_t gpuVertexBytes = 0;
+    size_t gpuIndexBytes = 0;
+    int textureCount = 0;
+    size_t textureBytes = 0;      // GPU bytes of the textures the model references, shared ones counted in full
+    size_t animationBytes = 0;    // Keyframe tracks and packed clips
 };
 
-
 class Model
 {
 public:
 
     vector<Mesh> meshes;
 
-    Model(string const& path, bool isCharacter, bool gamma = false) : gammaCorrection(gamma), isCharacter(isCharacter)
+    // Loads the cooked copy of the file when it is up to date, otherwise imports it and cooks it for next time
+    Model(string const& path, bool isCharacter, bool gamma = false, bool useCache = true)
+        : gammaCorrection(gamma), isCharacter(isCharacter), useCache(useCache), sourcePath(path)
     {
-        loadModel(path, isCharacter);
+        if (useCache && ModelCache::load(*this, path)) {
+            loadState = MODEL_READY;
+            return;
+        }
+        if (!readModel(path, false)) {
+            loadState = MODEL_FAILED;
+            return;
+        }
+        decodePendingTextures();
+        uploadPending(std::chrono::steady_clock::time_point::max());
     }
 
-    void Draw(Shader& shader, float alpha) {
+    // Loads in the background: the loader's threads read or import the file and decode its textures, then
+    // AssetLoader::update uploads it a few items per frame. Until isReady() only Draw, which draws the meshes
+    // uploaded so far, and the load state may be used.
+    Model(string const& path, bool isCharacter, AssetLoader& loader, bool gamma = false, bool useCache = true)
+        : gammaCorrection(gamma), isCharacter(isCharacter), useCache(useCache), sourcePath(path)
+    {
+        loadState = MODEL_LOADING;
+        loader.enqueue(*this);
+    }
 
-        if (isCharacter)
-        {
-            // Interpolate between previous and current bone transformations based on alpha
-            std::vector<glm::mat4> interpolatedTransforms = interpolateTransforms(prevBoneTransforms, boneTransforms, alpha);
+    // Owns its meshes' buffers and references on shared textures
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
 
-            // Now use interpolatedTransforms to update shader uniforms
-            updateBoneTransformations(shader, interpolatedTransforms);
+    // A model destroyed mid-load first waits for the loader threads to let go of it
+    ~Model()
+    {
+        if (loader) {
+            loader->cancel(*this);
         }
+        discardPendingTextures();  // Also left over when the loader was destroyed before the model
+        for (const Texture& texture : textures_loaded) {
+            sharedTextureCache().release(texture.id);
+        }
+    }
+
+    ModelLoadState getLoadState() const {
+        return static_cast<ModelLoadState>(loadState.load(std::memory_order_acquire));
+    }
+
+    bool isReady() const {
+        return getLoadState() == MODEL_READY;
+    }
+
+    // Share of the textures and meshes uploaded, 0 while the loader threads still work on the model
+    float getLoadProgress() const {
+        ModelLoadState state = getLoadState();
+        if (state == MODEL_READY) return 1.0f;
+        if (state != MODEL_UPLOADING) return 0.0f;
+        size_t total = pendingTextures.size() + pendingMeshes.size();
+        return total > 0 ? static_cast<float>(uploadedTextures + uploadedMeshes) / total : 1.0f;
+    }
 
-        // Draw each mesh with updated transformations
+    // Draws the meshes only, the bone palette of the character being drawn is uploaded by its AnimationInstance
+    void Draw(Shader& shader) {
         for (unsigned int i = 0; i < meshes.size(); i++) {
             meshes[i].Draw(shader);
         }
     }
 
-    void applyPose(float timeStep) {
-        static Animation* prevAnimation = nullptr;
-        Animation* currentAnimation = getActiveAnimation();
-        if (!currentAnimation) return;
-
-        if (prevAnimation != currentAnimation) {
-            blendPose(prevAnimation, currentAnimation, timeStep);
-            prevAnimation = currentAnimation;
+    // Frees the CPU geometry of every mesh once the model is uploaded. The bounds are computed by then; CPU skinning,
+    // the benchmarks and re-cooking need KEEP_FULL_GEOMETRY, collision and height queries KEEP_COLLISION_GEOMETRY.
+    void releaseMeshGeometry(MeshGeometryRetention retention) {
+        if (!isReady()) {
+            cout << "WARNING::MODEL:: " << sourcePath << " is not loaded yet, its geometry is kept." << endl;
+            return;
+        }
+        for (Mesh& mesh : meshes) {
+            mesh.releaseGeometry(retention);
         }
+    }
 
-        currentAnimationTime += timeStep;
-        if (currentAnimationTime > currentAnimation->duration) {
-            currentAnimationTime -= currentAnimation->duration;
+    ModelMemoryStats getMemoryStats() const {
+        ModelMemoryStats stats;
+        stats.meshCount = static_cast<int>(meshes.size());
+        for (const Mesh& mesh : meshes) {
+            stats.cpuGeometryBytes += mesh.getCpuGeometryBytes();
+            stats.gpuVertexBytes += mesh.getVertexBufferBytes();
+            stats.gpuIndexBytes += mesh.getIndexBufferBytes();
+        }
+        // Paths whose pixels matched share one texture, count it once
+        vector<unsigned int> textureIds;
+        for (const Texture& texture : textures_loaded) {
+            textureIds.push_back(texture.id);
+        }
+        std::sort(textureIds.begin(), textureIds.end());
+        textureIds.erase(std::unique(textureIds.begin(), textureIds.end()), textureIds.end());
+        stats.textureCount = static_cast<int>(textureIds.size());
+        for (unsigned int id : textureIds) {
+            stats.textureBytes += sharedTextureCache().getTextureBytes(id);
+        }
+        for (const auto& pair : animations) {
+            for (const BoneTransformTrack& track : pair.second.channels) {
+                stats.animationBytes += track.sizeInBytes();
+            }
+            if (pair.second.compressed.isValid()) {
+                stats.animationBytes += pair.second.compressed.sizeInBytes();
+            }
         }
+        return stats;
+    }
 
-        float adjustedTime = currentAnimationTime;
-        glm::mat4 identityMatrix = glm::mat4(1.0f);
-        glm::mat4 inverseIdentityMatrix = glm::inverse(identityMatrix);
-        getPose(*currentAnimation, skeleton, adjustedTime, boneTransforms, identityMatrix, inverseIdentityMatrix);
+    void printMemoryReport() const {
+        ModelMemoryStats stats = getMemoryStats();
+        cout << "MODEL::MEMORY:: " << sourcePath << " " << stats.meshCount << " meshes"
+            << " CPU geometry: " << stats.cpuGeometryBytes << " bytes"
+            << " GPU vertices: " << stats.gpuVertexBytes << " indices: " << stats.gpuIndexBytes
+            << " textures: " << stats.textureCount << ", " << stats.textureBytes << " bytes"
+            << " animations: " << stats.animationBytes << " bytes" << endl;
     }
 
-    void setActiveAnimation(const string& name) {
-        if (currentAnimationName != name) {
-            currentAnimationName = name;
-            auto it = animations.find(name);
-            if (it != animations.end()) {
-                std::for_each(animations.begin(), animations.end(), [&](auto& pair) { pair.second.active = false; });
-                it->second.active = true;
-                currentAnimationTime = 0.0f;  // Reset only when changing animations
-            }
+    const Skeleton& getSkeleton() const {
+        return skeleton;
+    }
+
+    const std::map<std::string, Animation>& getAnimations() const {
+        return animations;
+    }
+
+    const Animation* findAnimation(const string& name) const {
+        auto it = animations.find(name);
+        return it != animations.end() ? &it->second : nullptr;
+    }
+
+    // Handle of a clip by name, NO_CLIP if the model has none. Resolve once and keep the handle.
+    ClipHandle findClip(const string& name) const {
+        auto it = animations.find(name);
+        return it != animations.end() ? static_cast<ClipHandle>(std::distance(animations.begin(), it)) : NO_CLIP;
+    }
+
+    const Animation* getClip(ClipHandle clip) const {
+        return clip >= 0 && clip < static_cast<ClipHandle>(clips.size()) ? clips[clip] : nullptr;
+    }
+
+    // Clip the model plays for a state, NO_CLIP if it has none
+    ClipHandle getStateClip(AnimationState state) const {
+        return state >= 0 && state < ANIMATION_STATE_COUNT ? stateClips[state] : NO_CLIP;
+    }
+
+    int getClipCount() const {
+        return static_cast<int>(clips.size());
+    }
+
+    // Model-space box around every vertex in the bind pose
+    const BoundingBox& getBindBounds() const {
+        return bindBounds;
+    }
+
+    // Bind-space box around the vertices each bone ID influences. Invalid for bones that move no vertex.
+    const std::vector<BoundingBox>& getBoneBounds() const {
+        return boneBounds;
+    }
+
+    // Box around the vertices without bone weights, which the skinning shaders leave in place
+    const BoundingBox& getUnskinnedBounds() const {
+        return unskinnedBounds;
+    }
+
+    // Recomputes the per-clip bounds, e.g. after compressAnimations changed what the clips sample
+    void computeAnimatedBounds(const AnimatedBoundsSettings& settings = AnimatedBoundsSettings()) {
+        for (auto& pair : animations) {
+            pair.second.bounds = computeClipBounds(*this, pair.second, settings);
         }
+    }
 
+    // Size of the bone palette, one matrix per bone ID
+    int getBoneCount() const {
+        return static_cast<int>(boneIDMap.size());
     }
 
-    void updatePrevTransforms() {
-        prevBoneTransforms = boneTransforms;  // Store current transforms as previous
+    bool hasSkeleton() const {
+        return isCharacter && !skeleton.empty();
+    }
+
+    // Picks the shader GameObjectManager draws this model with, the palette format follows the shader
+    void setSkinningMode(SkinningMode mode) {
+        skinningMode = mode;
+    }
+
+    SkinningMode getSkinningMode() const {
+        return skinningMode;
+    }
+
+    // Resamples and packs every animation; from then on poses are decoded from the packed streams
+    void compressAnimations(const ClipCompressionSettings& settings) {
+        for (auto& pair : animations) {
+            ClipCompressionReport report = compressAnimation(pair.second, settings);
+            cout << "ANIMATION::COMPRESSION:: " << pair.first
+                << " bytes: " << report.sourceBytes << " -> " << report.compressedBytes
+                << " saved: " << static_cast<long long>(report.sourceBytes) - static_cast<long long>(report.compressedBytes)
+                << " constant tracks: " << report.constantTracks << "/" << report.totalTracks
+                << " max bone-space error: " << report.maxBoneSpaceError << endl;
+        }
     }
 
 private:
+    friend class ModelCache;
+    friend class AssetLoader;
 
-    vector<Texture> textures_loaded;
+    vector<Texture> textures_loaded;  // One reference into the shared texture cache each
+    unordered_map<string, size_t> textureIndexByPath;  // Into textures_loaded
 
     string directory;
     bool gammaCorrection;
     bool isCharacter;
+    bool useCache;
+    string sourcePath;  // Kept for loads an AssetLoader finishes and for the memory report
+
+    // Meshes and textures read on the CPU and waiting for upload
+    struct PendingTexture {
+        Texture texture;
+        string resolvedPath;
+        TextureImage image;
+    };
+    std::atomic<int> loadState{ MODEL_READY };
+    AssetLoader* loader = nullptr;  // Set while an AssetLoader has the model
+    JobSystem* loadJobs = nullptr;  // Loader threads while reading asynchronously, meshes and textures are split across them
+    vector<MeshData> pendingMeshes;
+    vector<PendingTexture> pendingTextures;
+    size_t uploadedTextures = 0;
+    size_t uploadedMeshes = 0;
+
+    // An aiMesh and the transform of the node that holds it
+    struct NodeMesh {
+        aiMesh* mesh;
+        glm::mat4 transform;
+    };
 
     map<string, aiNodeAnim*> boneAnimations;
     const aiScene* scene;
     Assimp::Importer importer;
 
-    vector<glm::mat4> boneTransforms;
-    vector<glm::mat4> prevBoneTransforms;
     unordered_map<string, BoneInfo> boneInfoMap;
-    Bone skeleton;
-    Animation animation;
+    map<string, int> boneIDMap;  // Bone IDs are numbered per model, in the order bones are first seen
+    SkinningMode skinningMode = LINEAR_BLEND_SKINNING;
+    Skeleton skeleton;
     std::map<std::string, Animation> animations;
-    float currentAnimationTime = 0.0f;
-    string currentAnimationName = "";
+    std::vector<const Animation*> clips;  // Indexed by ClipHandle, in the order of the animation map
+    std::vector<ClipHandle> stateClips = std::vector<ClipHandle>(ANIMATION_STATE_COUNT, NO_CLIP);
+    BoundingBox bindBounds;
+    std::vector<BoundingBox> boneBounds;
+    BoundingBox unskinnedBounds;
 
     bool fileExists(const string& path)
     {
@@ -174,13 +353,113 @@ private:
         return file.good();
     }
 
-    void loadModel(string const& path, bool isCharacter)
+    // CPU half of loading, safe on a loader thread: reads the cooked copy, or imports the file and cooks it.
+    // Leaves the geometry in pendingMeshes.
+    bool readModel(const string& path, bool readCache)
+    {
+        if (readCache && ModelCache::read(*this, path)) {
+            return true;
+        }
+        if (!loadModel(path, isCharacter)) {
+            return false;
+        }
+        if (useCache && !pendingMeshes.empty()) {
+            ModelCache::write(*this, path);
+        }
+        return true;
+    }
+
+    // Loader thread half of an asynchronous load, loadJobs was set by AssetLoader::enqueue
+    void readOnLoader()
+    {
+        bool loaded = readModel(sourcePath, useCache);
+        if (loaded) {
+            decodePendingTextures();
+        }
+        loadJobs = nullptr;
+        loadState.store(loaded ? MODEL_UPLOADING : MODEL_FAILED, std::memory_order_release);
+    }
+
+    // Runs fn(i) for every i in [0, count), spread over the loader threads when loading asynchronously
+    template <typename Fn>
+    void forEachItem(int count, Fn& fn)
+    {
+        if (loadJobs && count > 1) {
+            JobGroup group;
+            loadJobs->parallelFor(group, count, 1, fn);
+            loadJobs->wait(group);
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            fn(i);
+        }
+    }
+
+    // Decodes every texture the pending meshes use once, skipping those another model has loaded already
+    void decodePendingTextures()
+    {
+        unordered_map<string, bool> seen;
+        for (const MeshData& mesh : pendingMeshes) {
+            for (const Texture& texture : mesh.textures) {
+                if (!seen.insert({ texture.path, true }).second) continue;
+                PendingTexture pending;
+                pending.texture = texture;
+                pending.resolvedPath = resolveTexturePath(texture.path.c_str(), directory);
+                pendingTextures.push_back(pending);
+            }
+        }
+        auto decode = [this](int i) {
+            PendingTexture& pending = pendingTextures[i];
+            if (!sharedTextureCache().isCached(pending.resolvedPath)) {
+                decodeTextureImage(pending.resolvedPath, pending.image, getTextureUsage(pending.texture.type));
+            }
+        };
+        forEachItem(static_cast<int>(pendingTextures.size()), decode);
+    }
+
+    // Frees the images decoded for textures that were never uploaded. uploadPending hands the others to the cache.
+    void discardPendingTextures()
+    {
+        for (size_t i = uploadedTextures; i < pendingTextures.size(); i++) {
+            freeTextureImage(pendingTextures[i].image);
+        }
+    }
+
+    // GL half of loading: uploads the pending textures, then the meshes, one at a time until the deadline.
+    // Returns true once everything is uploaded and the model is ready.
+    bool uploadPending(std::chrono::steady_clock::time_point deadline)
+    {
+        while (uploadedTextures < pendingTextures.size()) {
+            PendingTexture& pending = pendingTextures[uploadedTextures++];
+            pending.texture.id = sharedTextureCache().acquire(pending.resolvedPath, &pending.image, getTextureUsage(pending.texture.type));
+            textureIndexByPath[pending.texture.path] = textures_loaded.size();
+            textures_loaded.push_back(pending.texture);
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+        }
+        meshes.reserve(pendingMeshes.size());
+        while (uploadedMeshes < pendingMeshes.size()) {
+            MeshData& data = pendingMeshes[uploadedMeshes++];
+            for (Texture& texture : data.textures) {
+                texture = loadTexture(texture.path, texture.type);
+            }
+            meshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(data.textures));
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+        }
+        pendingMeshes.clear();
+        pendingTextures.clear();
+        uploadedTextures = 0;
+        uploadedMeshes = 0;
+        loadState.store(MODEL_READY, std::memory_order_release);
+        return true;
+    }
+
+    bool loadModel(string const& path, bool isCharacter)
     {
         if (!fileExists(path))
         {
             cout << "ERROR::ASSIMP:: File not found." << endl;
             cout << "PATH: " << path.c_str() << endl;
-            return;
+            return false;
         }
 
         scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights | aiProcess_GlobalScale);
@@ -189,56 +468,116 @@ private:
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             cout << "PATH: " << path.c_str() << endl;
-            return;
+            return false;
         }
 
         if (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)
         {
             cout << "ERROR::ASSIMP:: Scene is incomplete." << endl;
             cout << "PATH: " << path.c_str() << endl;
-            return;
+            return false;
         }
 
         if (!scene->mRootNode)
         {
             cout << "ERROR::ASSIMP:: Root node is null." << endl;
             cout << "PATH: " << path.c_str() << endl;
-            return;
+            return false;
         }
 
         directory = path.substr(0, path.find_last_of('/'));
 
         if (isCharacter)
         {
-            skeleton.name = scene->mRootNode->mName.C_Str();
-            skeleton.id = getBoneID(skeleton.name);
-            parseBoneHierarchy(scene->mRootNode, skeleton, scene);
+            parseBoneHierarchy(scene->mRootNode, Skeleton::NO_PARENT, scene);
         }
 
         glm::mat4 globalTransform = glm::mat4(1.0f);
-        processNode(scene->mRootNode, scene, globalTransform);
+        vector<NodeMesh> nodeMeshes;
+        processNode(scene->mRootNode, scene, globalTransform, nodeMeshes);
+
+        // Meshes are independent of each other, bone weights are added in order below
+        pendingMeshes.resize(nodeMeshes.size());
+        auto buildMesh = [&](int i) {
+            pendingMeshes[i] = processMesh(nodeMeshes[i].mesh, scene, nodeMeshes[i].transform);
+        };
+        forEachItem(static_cast<int>(nodeMeshes.size()), buildMesh);
+
+        if (isCharacter)
+        {
+            for (size_t i = 0; i < nodeMeshes.size(); i++) {
+                processBones(nodeMeshes[i].mesh, pendingMeshes[i].vertices);
+            }
+        }
+
+        computeMeshBounds(pendingMeshes);
         if (isCharacter)
         {
             processAnimations(scene);
-            setActiveAnimation(getAnimationString(IDLE));
+            resolveClips();
+            computeAnimatedBounds();
+        }
+        return true;
+    }
+
+    // Bone boxes hold every vertex the bone influences. Weights are normalized by processBones, so the skinned vertex
+    // sum(w * M * v) is a convex combination of the bones' transforms of the unscaled vertex.
+    // Takes Mesh or MeshData, the geometry is still pending right after an import.
+    template <typename MeshType>
+    void computeMeshBounds(const vector<MeshType>& meshList) {
+        boneBounds.assign(getBoneCount(), BoundingBox());
+        for (const MeshType& mesh : meshList) {
+            for (const Vertex& vertex : mesh.vertices) {
+                bindBounds.expand(vertex.Position);
+                float weightSum = vertex.Weights[0] + vertex.Weights[1] + vertex.Weights[2] + vertex.Weights[3];
+                if (weightSum <= 0.0f) {
+                    unskinnedBounds.expand(vertex.Position);
+                    continue;
+                }
+                for (int i = 0; i < 4; i++) {
+                    if (vertex.Weights[i] > 0.0f && vertex.BoneIDs[i] >= 0 && vertex.BoneIDs[i] < getBoneCount()) {
+                        boneBounds[vertex.BoneIDs[i]].expand(vertex.Position);
+                    }
+                }
+            }
         }
     }
 
-    void processNode(aiNode* node, const aiScene* scene, const glm::mat4& parentTransform) {
+    // Numbers the clips and maps every AnimationState to its clip, so a state the asset has no clip for
+    // is reported here rather than ignored each time it is played
+    void resolveClips() {
+        clips.clear();
+        for (const auto& pair : animations) {
+            clips.push_back(&pair.second);
+        }
+        for (int state = 0; state < ANIMATION_STATE_COUNT; state++) {
+            string name = getAnimationString(static_cast<AnimationState>(state));
+            stateClips[state] = findClip(name);
+            if (stateClips[state] == NO_CLIP) {
+                cout << "WARNING::ANIMATION:: No clip named \"" << name << "\" for animation state " << state << "." << endl;
+            }
+        }
+    }
+
+    void processNode(aiNode* node, const aiScene* scene, const glm::mat4& parentTransform, vector<NodeMesh>& nodeMeshes) {
         glm::mat4 nodeTransform = assimpToGlmMat4(node->mTransformation);
         glm::mat4 globalTransform = parentTransform * nodeTransform;
 
         //cout << "Node: " << node->mName.C_Str() << "Meshes: " << node->mNumMeshes << endl;
         for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene, globalTransform));
+            NodeMesh nodeMesh;
+            nodeMesh.mesh = scene->mMeshes[node->mMeshes[i]];
+            nodeMesh.transform = globalTransform;
+            nodeMeshes.push_back(nodeMesh);
         }
         for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            processNode(node->mChildren[i], scene, globalTransform);
+            processNode(node->mChildren[i], scene, globalTransform, nodeMeshes);
         }
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4& globalTransform) {
+    // Builds the vertex and index arrays of one mesh without touching GL or shared model state, so meshes can be
+    // processed in parallel
+    MeshData processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4& globalTransform) {
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
@@ -301,12 +640,11 @@ private:
         vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        if (isCharacter)
-        {
-            processBones(mesh, vertices);
-        }
-
-        return Mesh(vertices, indices, textures);
+        MeshData data;
+        data.vertices = std::move(vertices);
+        data.indices = std::move(indices);
+        data.textures = std::move(textures);
+        return data;
     }
 
     void processBones(aiMesh* mesh, vector<Vertex>& vertices)
@@ -322,9 +660,9 @@ private:
                 boneInfoMap[bone->mName.C_Str()] = boneInfo;
             }
 
-            Bone* skeletonBone = findBone(skeleton, bone->mName.C_Str());
-            if (skeletonBone) {
-                skeletonBone->offset = assimpToGlmMat4(bone->mOffsetMatrix);
+            int joint = findBone(bone->mName.C_Str());
+            if (joint != Skeleton::NO_JOINT) {
+                skeleton.offsets[joint] = assimpToGlmMat4(bone->mOffsetMatrix);
             }
 
             for (unsigned int j = 0; j < bone->mNumWeights; j++)
@@ -335,6 +673,15 @@ private:
                 addBoneData(vertices[vertexID], boneID, weightValue);
             }
         }
+
+        // Weights summing to one make the CPU and pre-skinned paths, which do not divide by the sum, draw the same
+        // position as the shaders, which do through w
+        for (Vertex& vertex : vertices) {
+            float weightSum = vertex.Weights[0] + vertex.Weights[1] + vertex.Weights[2] + vertex.Weights[3];
+            if (weightSum > 0.0f) {
+                vertex.Weights /= weightSum;
+            }
+        }
     }
 
     void addBoneData(Vertex& vertex, int boneID, float weight)
@@ -350,6 +697,7 @@ private:
         }
     }
 
+    // References only, the textures are decoded and uploaded with the rest of the pending data
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
@@ -357,29 +705,32 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    break;
-                }
-            }
-            if (!skip)
-            {
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
 
+    // Takes one reference per model from the shared texture cache, later uses in this model share it
+    Texture loadTexture(const string& path, const string& typeName)
+    {
+        auto it = textureIndexByPath.find(path);
+        if (it != textureIndexByPath.end())
+        {
+            return textures_loaded[it->second];
+        }
+        Texture texture;
+        texture.id = sharedTextureCache().acquire(resolveTexturePath(path.c_str(), this->directory), nullptr, getTextureUsage(typeName));
+        texture.type = typeName;
+        texture.path = path;
+        textureIndexByPath[path] = textures_loaded.size();
+        textures_loaded.push_back(texture);
+        return texture;
+    }
+
     void processAnimations(const aiScene* scene) {
         for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
             aiAnimation* ai_anim = scene->mAnimations[i];
@@ -414,7 +765,19 @@ private:
                     track.scales.push_back(assimpToGlmVec3(key.mValue));
                 }
 
-                animation.boneTransforms[channel->mNodeName.C_Str()] = track;
+                animation.channelsByName[channel->mNodeName.C_Str()] = static_cast<int>(animation.channels.size());
+                animation.channels.push_back(track);
+            }
+
+            // Resolve every channel to its joint once, so sampling never looks up names
+            animation.jointChannels.assign(skeleton.size(), NO_CHANNEL);
+            for (const auto& pair : animation.channelsByName) {
+                int joint = findBone(pair.first);
+                if (joint == Skeleton::NO_JOINT) {
+                    cout << "WARNING::ANIMATION:: Channel " << pair.first << " has no matching bone." << endl;
+                    continue;
+                }
+                animation.jointChannels[joint] = pair.second;
             }
 
             animations[ai_anim->mName.C_Str()] = animation;
@@ -429,99 +792,28 @@ private:
         return glm::quat(quat.w, quat.x, quat.y, quat.z);
     }
 
-    void parseBoneHierarchy(aiNode* node, Bone& parentBone, const aiScene* scene)
+    // Appends the node hierarchy to the skeleton depth-first, so parents are always added before their children
+    void parseBoneHierarchy(aiNode* node, int parentJoint, const aiScene* scene)
     {
-        Bone bone;
-        bone.name = node->mName.C_Str();
-        bone.id = getBoneID(bone.name);
-        bone.offset = glm::mat4(1.0f);
+        string name = node->mName.C_Str();
+        int joint = skeleton.addJoint(name, parentJoint, getBoneID(name));
 
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            parseBoneHierarchy(node->mChildren[i], bone, scene);
+            parseBoneHierarchy(node->mChildren[i], joint, scene);
         }
-
-        parentBone.children.push_back(bone);
-    }
-
-    void getPose(Animation& animation, Bone& skeleton, float dt, std::vector<glm::mat4>& output, glm::mat4& parentTransform, glm::mat4& globalInverseTransform) {
-
-        if (animation.boneTransforms.find(skeleton.name) == animation.boneTransforms.end()) {
-            // If no animation data for this bone, use parent transform for children
-            for (Bone& child : skeleton.children) {
-                getPose(animation, child, dt, output, parentTransform, globalInverseTransform);
-            }
-            return;
-        }
-
-        BoneTransformTrack& btt = animation.boneTransforms[skeleton.name];
-        dt = fmod(dt, animation.duration);  // Wrap time around the duration
-
-        // Interpolate position
-        std::pair<uint, float> fp = getTimeFraction(btt.positionTimestamps, dt, 1);
-        glm::vec3 position = lerp(btt.positions[fp.first - 1], btt.positions[fp.first], fp.second);
-
-        // Interpolate rotation
-        fp = getTimeFraction(btt.rotationTimestamps, dt, 1);
-        glm::quat rotation = glm::slerp(btt.rotations[fp.first - 1], btt.rotations[fp.first], fp.second);
-
-        // Interpolate scale
-        fp = getTimeFraction(btt.scaleTimestamps, dt, 1);
-        glm::vec3 scale = lerp(btt.scales[fp.first - 1], btt.scales[fp.first], fp.second);
-
-        glm::mat4 positionMat = glm::translate(glm::mat4(1.0f), position);
-        glm::mat4 rotationMat = glm::mat4_cast(rotation);
-        glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
-
-        glm::mat4 localTransform = positionMat * rotationMat * scaleMat;
-        glm::mat4 globalTransform = parentTransform * localTransform;
-
-        output[skeleton.id] = globalInverseTransform * globalTransform * skeleton.offset;
-
-        for (Bone& child : skeleton.children) {
-            getPose(animation, child, dt, output, globalTransform, globalInverseTransform);
-        }
-    }
-
-    std::pair<uint, float> getTimeFraction(std::vector<float>& times, float time, uint startFrame) {
-        if (times.empty()) {
-            return { 0, 0.0f };  // Return defaults if no keyframes are present
-        }
-
-        if (times.size() == 1) {
-            return { 0, 0.0f };  // Only one keyframe, no interpolation needed
-        }
-
-        uint frame = startFrame;
-        while (frame < times.size() && time >= times[frame]) {
-            frame++;
-        }
-        if (frame == 0) {  // Handle case where startFrame is 0 and no increment occurs
-            return { 0, 0.0f };
-        }
-
-        // Ensure frame does not exceed bounds and is at least 1 to prevent underflow in array access
-        frame = std::min(frame, static_cast<uint>(times.size() - 1));
-        frame = std::max(1u, frame);
-
-        float lastTime = times[frame - 1];
-        float nextTime = times[frame];
-        float fraction = (time - lastTime) / (nextTime - lastTime);
-
-        return { frame, fraction };
     }
 
     int getBoneID(const string& boneName)
     {
-        static map<string, int> boneIDMap;
-        static int nextBoneID = 0;
-
-        if (boneIDMap.find(boneName) == boneIDMap.end())
+        auto it = boneIDMap.find(boneName);
+        if (it == boneIDMap.end())
         {
-            boneIDMap[boneName] = nextBoneID++;
-            boneTransforms.push_back(glm::mat4(1.0f));
+            int boneID = static_cast<int>(boneIDMap.size());
+            boneIDMap[boneName] = boneID;
+            return boneID;
         }
-        return boneIDMap[boneName];
+        return it->second;
     }
 
     glm::mat4 assimpToGlmMat4(const aiMatrix4x4& from) {
@@ -538,57 +830,8 @@ private:
         return to;
     }
 
-    Bone* findBone(Bone& bone, const string& name)
+    int findBone(const string& name)
     {
-        if (bone.name == name) return &bone;
-        for (auto& child : bone.children)
-        {
-            Bone* found = findBone(child, name);
-            if (found) return found;
-        }
-        return nullptr;
-    }
-
-    Animation* getActiveAnimation() {
-        auto it = animations.find(currentAnimationName);
-        if (it != animations.end()) return &it->second;
-        return nullptr;
-    }
-
-    std::vector<glm::mat4> interpolateTransforms(const std::vector<glm::mat4>& prevTransforms,
-        const std::vector<glm::mat4>& currentTransforms, float alpha) {
-        std::vector<glm::mat4> interpolatedTransforms;
-        for (size_t i = 0; i < currentTransforms.size(); ++i) {
-            glm::mat4 prevTransform = prevTransforms[i];
-            glm::mat4 currentTransform = currentTransforms[i];
-
-            glm::mat4 interpolated = lerp(prevTransform, currentTransform, alpha);
-            interpolatedTransforms.push_back(interpolated);
-        }
-        return interpolatedTransforms;
-    }
-
-    void blendPose(Animation* prevAnimation, Animation* currentAnimation, float blendFactor) {
-        if (!prevAnimation || !currentAnimation) return;
-
-        // Example blending - adjust according to actual bone indices and ensure both animations are compatible
-        for (auto& bone : skeleton.children) {
-            auto prevTrack = prevAnimation->boneTransforms.find(bone.name);
-            auto currentTrack = currentAnimation->boneTransforms.find(bone.name);
-            if (prevTrack != prevAnimation->boneTransforms.end() && currentTrack != currentAnimation->boneTransforms.end()) {
-                // Interpolate each bone's transform from the last frame of prevAnimation and the first frame of currentAnimation
-                glm::vec3 position = lerp(prevTrack->second.positions.back(), currentTrack->second.positions.front(), blendFactor);
-                glm::quat rotation = glm::slerp(prevTrack->second.rotations.back(), currentTrack->second.rotations.front(), blendFactor);
-                glm::vec3 scale = lerp(prevTrack->second.scales.back(), currentTrack->second.scales.front(), blendFactor);
-
-                glm::mat4 posMat = glm::translate(glm::mat4(1.0f), position);
-                glm::mat4 rotMat = glm::mat4_cast(rotation);
-                glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
-                glm::mat4 finalTransform = posMat * rotMat * scaleMat;
-
-                // Here, instead of directly setting, you might want to adjust how these are applied based on your skeleton structure
-                boneTransforms[bone.id] = finalTransform;
-            }
-        }
+        return skeleton.findJoint(name);
     }
 };
\ No newline at end of file
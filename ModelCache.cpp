@@ -0,0 +1,540 @@
+#include "ModelCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+#include "MappedFile.h"
+#include "Model.h"
+
+namespace
+{
+    struct CookedModelHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexSize;      // sizeof(Vertex) of the build that cooked it
+        uint32_t isCharacter;
+        uint64_t sourceSize;
+        int64_t sourceModifiedTime;
+        uint64_t fileSize;        // Catches truncated writes
+    };
+
+    const size_t COOKED_ALIGNMENT = 16;
+    std::atomic<unsigned int> tempFileCounter{ 0 };
+
+    class CookedWriter
+    {
+    public:
+        std::vector<uint8_t> bytes;
+
+        template <typename T>
+        void write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Only plain data is cooked");
+            append(&value, sizeof(T));
+        }
+
+        // Count, then the elements aligned so they can be used in place from the mapping
+        template <typename T>
+        void writeArray(const T* values, size_t count)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Only plain data is cooked");
+            write(static_cast<uint32_t>(count));
+            align();
+            append(values, count * sizeof(T));
+        }
+
+        template <typename T>
+        void writeVector(const std::vector<T>& values)
+        {
+            writeArray(values.data(), values.size());
+        }
+
+        void writeString(const std::string& value)
+        {
+            write(static_cast<uint32_t>(value.size()));
+            append(value.data(), value.size());
+        }
+
+    private:
+        void append(const void* data, size_t size)
+        {
+            const uint8_t* first = static_cast<const uint8_t*>(data);
+            bytes.insert(bytes.end(), first, first + size);
+        }
+
+        void align()
+        {
+            bytes.resize((bytes.size() + COOKED_ALIGNMENT - 1) / COOKED_ALIGNMENT * COOKED_ALIGNMENT, 0);
+        }
+    };
+
+    // Bounds-checked walk over the mapping. Any read past the end fails this and every later read.
+    class CookedReader
+    {
+    public:
+        CookedReader(const uint8_t* data, size_t size) : data(data), size(size)
+        {
+
+        }
+
+        bool isValid() const {
+            return valid;
+        }
+
+        template <typename T>
+        bool read(T& value)
+        {
+            const uint8_t* bytes = take(sizeof(T));
+            if (bytes) memcpy(&value, bytes, sizeof(T));
+            return bytes != nullptr;
+        }
+
+        // Elements in place in the mapping
+        template <typename T>
+        const T* readArray(uint32_t& count)
+        {
+            count = 0;
+            if (!read(count)) return nullptr;
+            offset = (offset + COOKED_ALIGNMENT - 1) / COOKED_ALIGNMENT * COOKED_ALIGNMENT;
+            const T* values = reinterpret_cast<const T*>(take(static_cast<size_t>(count) * sizeof(T)));
+            if (!values) count = 0;
+            return values;
+        }
+
+        template <typename T>
+        bool readVector(std::vector<T>& values)
+        {
+            uint32_t count;
+            const T* first = readArray<T>(count);
+            values.resize(count);
+            if (count > 0) memcpy(values.data(), first, count * sizeof(T));
+            return valid;
+        }
+
+        bool readString(std::string& value)
+        {
+            uint32_t length = 0;
+            if (!read(length)) return false;
+            const uint8_t* bytes = take(length);
+            if (bytes) value.assign(reinterpret_cast<const char*>(bytes), length);
+            return bytes != nullptr;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+        bool valid = true;
+
+        const uint8_t* take(size_t count)
+        {
+            if (!valid || count > size || offset > size - count) {
+                valid = false;
+                return nullptr;
+            }
+            const uint8_t* bytes = data + offset;
+            offset += count;
+            return bytes;
+        }
+    };
+
+    struct CookedTexture
+    {
+        std::string type;
+        std::string path;
+    };
+
+    // A mesh still in the mapping, uploaded once the whole file has been read
+    struct CookedMesh
+    {
+        const Vertex* vertices = nullptr;
+        uint32_t vertexCount = 0;
+        const unsigned int* indices = nullptr;
+        uint32_t indexCount = 0;
+        std::vector<CookedTexture> textures;
+    };
+
+    // Mesh and MeshData share their member names
+    template <typename MeshType>
+    void writeMeshes(CookedWriter& writer, const std::vector<MeshType>& meshes)
+    {
+        writer.write(static_cast<uint32_t>(meshes.size()));
+        for (const MeshType& mesh : meshes) {
+            writer.writeVector(mesh.vertices);
+            writer.writeVector(mesh.indices);
+            writer.write(static_cast<uint32_t>(mesh.textures.size()));
+            for (const Texture& texture : mesh.textures) {
+                writer.writeString(texture.type);
+                writer.writeString(texture.path);
+            }
+        }
+    }
+
+    void writeTrack(CookedWriter& writer, const BoneTransformTrack& track)
+    {
+        writer.writeVector(track.positionTimestamps);
+        writer.writeVector(track.rotationTimestamps);
+        writer.writeVector(track.scaleTimestamps);
+        writer.writeVector(track.positions);
+        writer.writeVector(track.rotations);
+        writer.writeVector(track.scales);
+    }
+
+    bool readTrack(CookedReader& reader, BoneTransformTrack& track)
+    {
+        reader.readVector(track.positionTimestamps);
+        reader.readVector(track.rotationTimestamps);
+        reader.readVector(track.scaleTimestamps);
+        reader.readVector(track.positions);
+        reader.readVector(track.rotations);
+        return reader.readVector(track.scales);
+    }
+
+    // Whether every bone ID a weighted influence uses and every index stays inside the mesh and the palette
+    bool meshInRange(const CookedMesh& mesh, uint32_t boneCount)
+    {
+        for (uint32_t i = 0; i < mesh.indexCount; i++) {
+            if (mesh.indices[i] >= mesh.vertexCount) return false;
+        }
+        for (uint32_t v = 0; v < mesh.vertexCount; v++) {
+            const Vertex& vertex = mesh.vertices[v];
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+                if (vertex.Weights[k] == 0.0f) continue;
+                if (vertex.BoneIDs[k] < 0 || static_cast<uint32_t>(vertex.BoneIDs[k]) >= boneCount) return false;
+            }
+        }
+        return true;
+    }
+
+    bool trackInRange(const PackedTrack& track, bool isRotation, uint32_t frameStride)
+    {
+        // Read as an integer, the file may hold a value outside the enum
+        std::underlying_type<TrackFormat>::type format;
+        memcpy(&format, &track.format, sizeof(format));
+        if (format < TRACK_CONSTANT || format > TRACK_RAW) return false;
+        if (track.format == TRACK_CONSTANT) return true;
+        return static_cast<uint64_t>(track.frameOffset) + packedTrackSize(track.format, isRotation) <= frameStride;
+    }
+
+    // Whether the joints' channel indices and the packed stream agree with the clip's channels,
+    // so sampling never reads past them
+    bool animationInRange(const Animation& animation)
+    {
+        for (int channel : animation.jointChannels) {
+            if (channel != NO_CHANNEL && (channel < 0 || static_cast<size_t>(channel) >= animation.channels.size())) return false;
+        }
+
+        const CompressedClip& compressed = animation.compressed;
+        if (!compressed.isValid()) return true;
+        if (compressed.channels.size() != animation.channels.size()
+            || compressed.frames.size() != static_cast<uint64_t>(compressed.frameCount) * compressed.frameStride) {
+            return false;
+        }
+        for (const PackedChannel& channel : compressed.channels) {
+            if (!trackInRange(channel.position, false, compressed.frameStride)
+                || !trackInRange(channel.rotation, true, compressed.frameStride)
+                || !trackInRange(channel.scale, false, compressed.frameStride)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+std::string ModelCache::getCachePath(const std::string& sourcePath)
+{
+    return sourcePath + COOKED_MODEL_EXTENSION;
+}
+
+bool ModelCache::write(const Model& model, const std::string& sourcePath)
+{
+    for (const Mesh& mesh : model.meshes) {
+        if (!mesh.hasFullGeometry()) {
+            std::cout << "WARNING::MODEL_CACHE:: " << sourcePath << " released its mesh geometry, nothing cooked." << std::endl;
+            return false;
+        }
+    }
+
+    CookedModelHeader header = {};
+    header.magic = COOKED_MODEL_MAGIC;
+    header.version = COOKED_MODEL_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.isCharacter = model.isCharacter ? 1 : 0;
+    if (!getFileStamp(sourcePath, header.sourceSize, header.sourceModifiedTime)) {
+        std::cout << "WARNING::MODEL_CACHE:: Source " << sourcePath << " not found, nothing cooked." << std::endl;
+        return false;
+    }
+
+    CookedWriter writer;
+    writer.write(header);
+
+    // Geometry is still pending when cooked right after an import, uploaded otherwise
+    if (!model.pendingMeshes.empty()) {
+        writeMeshes(writer, model.pendingMeshes);
+    }
+    else {
+        writeMeshes(writer, model.meshes);
+    }
+
+    std::vector<std::string> boneNames(model.boneIDMap.size());
+    for (const auto& pair : model.boneIDMap) {
+        boneNames[pair.second] = pair.first;
+    }
+    writer.write(static_cast<uint32_t>(boneNames.size()));
+    for (const std::string& name : boneNames) {
+        writer.writeString(name);
+    }
+
+    const Skeleton& skeleton = model.skeleton;
+    writer.write(static_cast<uint32_t>(skeleton.size()));
+    for (int i = 0; i < skeleton.size(); i++) {
+        writer.writeString(skeleton.names[i]);
+    }
+    writer.writeVector(skeleton.parents);
+    writer.writeVector(skeleton.boneIDs);
+    writer.writeVector(skeleton.offsets);
+
+    writer.write(static_cast<uint32_t>(model.animations.size()));
+    for (const auto& pair : model.animations) {
+        const Animation& animation = pair.second;
+        writer.writeString(pair.first);
+        writer.write(animation.duration);
+        writer.write(animation.ticksPerSecond);
+
+        std::vector<std::string> channelNames(animation.channels.size());
+        for (const auto& channel : animation.channelsByName) {
+            channelNames[channel.second] = channel.first;
+        }
+        writer.write(static_cast<uint32_t>(animation.channels.size()));
+        for (size_t c = 0; c < animation.channels.size(); c++) {
+            writer.writeString(channelNames[c]);
+            writeTrack(writer, animation.channels[c]);
+        }
+        writer.writeVector(animation.jointChannels);
+
+        const CompressedClip& compressed = animation.compressed;
+        writer.write(compressed.startTime);
+        writer.write(compressed.frameInterval);
+        writer.write(compressed.frameCount);
+        writer.write(compressed.frameStride);
+        writer.writeVector(compressed.channels);
+        writer.writeVector(compressed.frames);
+
+        writer.write(animation.bounds.segmentDuration);
+        writer.writeVector(animation.bounds.segments);
+        writer.write(animation.bounds.clip);
+    }
+
+    header.fileSize = writer.bytes.size();
+    memcpy(writer.bytes.data(), &header, sizeof(header));
+
+    // Written aside and renamed, so a crash mid-write never leaves a cooked file that looks complete
+    std::string cachePath = getCachePath(sourcePath);
+    std::string tempPath = cachePath + ".tmp" + std::to_string(tempFileCounter.fetch_add(1));  // Loader threads may cook the same file at once
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+        if (!file) {
+            std::cout << "WARNING::MODEL_CACHE:: Could not write " << tempPath << "." << std::endl;
+            return false;
+        }
+    }
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::cout << "WARNING::MODEL_CACHE:: Could not move " << tempPath << " to " << cachePath << "." << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    std::cout << "MODEL_CACHE:: Cooked " << sourcePath << " into " << cachePath << ", " << writer.bytes.size() << " bytes" << std::endl;
+    return true;
+}
+
+// Everything read from a cooked file, the mesh geometry still in the mapping
+struct ModelCache::CookedModel
+{
+    MappedFile file;
+    std::vector<CookedMesh> meshes;
+    std::vector<std::string> boneNames;
+    std::vector<std::string> jointNames;
+    std::vector<int> parents;
+    std::vector<int> boneIDs;
+    std::vector<glm::mat4> offsets;
+    std::map<std::string, Animation> animations;
+};
+
+bool ModelCache::parse(bool isCharacter, const std::string& sourcePath, CookedModel& cooked)
+{
+    std::string cachePath = getCachePath(sourcePath);
+    MappedFile& file = cooked.file;
+    if (!file.open(cachePath)) return false;
+
+    CookedReader reader(file.getData(), file.getSize());
+    CookedModelHeader header;
+    if (!reader.read(header) || header.magic != COOKED_MODEL_MAGIC || header.version != COOKED_MODEL_VERSION
+        || header.vertexSize != sizeof(Vertex) || header.fileSize != file.getSize()) {
+        std::cout << "MODEL_CACHE:: " << cachePath << " is from another version or incomplete, importing " << sourcePath << std::endl;
+        return false;
+    }
+    if (header.isCharacter != (isCharacter ? 1u : 0u)) {
+        std::cout << "MODEL_CACHE:: " << cachePath << " was cooked for another model type, importing " << sourcePath << std::endl;
+        return false;
+    }
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    if (getFileStamp(sourcePath, sourceSize, sourceModifiedTime)
+        && (sourceSize != header.sourceSize || sourceModifiedTime != header.sourceModifiedTime)) {
+        std::cout << "MODEL_CACHE:: " << cachePath << " is stale, importing " << sourcePath << std::endl;
+        return false;
+    }
+
+    // Read everything before touching the model, so a damaged file falls back to the importer cleanly
+    uint32_t meshCount = 0;
+    reader.read(meshCount);
+    std::vector<CookedMesh>& meshes = cooked.meshes;
+    meshes.resize(reader.isValid() ? meshCount : 0);
+    for (CookedMesh& mesh : meshes) {
+        mesh.vertices = reader.readArray<Vertex>(mesh.vertexCount);
+        mesh.indices = reader.readArray<unsigned int>(mesh.indexCount);
+        uint32_t textureCount = 0;
+        reader.read(textureCount);
+        for (uint32_t t = 0; t < textureCount && reader.isValid(); t++) {
+            CookedTexture texture;
+            reader.readString(texture.type);
+            reader.readString(texture.path);
+            mesh.textures.push_back(texture);
+        }
+    }
+
+    uint32_t boneCount = 0;
+    reader.read(boneCount);
+    cooked.boneNames.resize(reader.isValid() ? boneCount : 0);
+    for (std::string& name : cooked.boneNames) {
+        reader.readString(name);
+    }
+
+    uint32_t jointCount = 0;
+    reader.read(jointCount);
+    cooked.jointNames.resize(reader.isValid() ? jointCount : 0);
+    for (std::string& name : cooked.jointNames) {
+        reader.readString(name);
+    }
+    reader.readVector(cooked.parents);
+    reader.readVector(cooked.boneIDs);
+    reader.readVector(cooked.offsets);
+    bool consistent = cooked.jointNames.size() == jointCount && cooked.parents.size() == jointCount
+        && cooked.boneIDs.size() == jointCount && cooked.offsets.size() == jointCount;
+    for (uint32_t i = 0; consistent && i < jointCount; i++) {
+        consistent = cooked.parents[i] >= Skeleton::NO_PARENT
+            && cooked.parents[i] < static_cast<int>(i)  // Topological order, as addJoint requires
+            && cooked.boneIDs[i] >= 0 && static_cast<uint32_t>(cooked.boneIDs[i]) < boneCount;
+    }
+    for (size_t m = 0; consistent && reader.isValid() && m < meshes.size(); m++) {
+        consistent = meshInRange(meshes[m], boneCount);
+    }
+
+    std::map<std::string, Animation>& animations = cooked.animations;
+    uint32_t animationCount = 0;
+    reader.read(animationCount);
+    for (uint32_t a = 0; a < animationCount && reader.isValid(); a++) {
+        std::string name;
+        reader.readString(name);
+        Animation& animation = animations[name];
+        reader.read(animation.duration);
+        reader.read(animation.ticksPerSecond);
+
+        uint32_t channelCount = 0;
+        reader.read(channelCount);
+        animation.channels.resize(reader.isValid() ? channelCount : 0);
+        for (uint32_t c = 0; c < channelCount && reader.isValid(); c++) {
+            std::string channelName;
+            reader.readString(channelName);
+            animation.channelsByName[channelName] = static_cast<int>(c);
+            readTrack(reader, animation.channels[c]);
+        }
+        reader.readVector(animation.jointChannels);
+        consistent = consistent && animation.jointChannels.size() == jointCount;
+
+        CompressedClip& compressed = animation.compressed;
+        reader.read(compressed.startTime);
+        reader.read(compressed.frameInterval);
+        reader.read(compressed.frameCount);
+        reader.read(compressed.frameStride);
+        reader.readVector(compressed.channels);
+        reader.readVector(compressed.frames);
+
+        reader.read(animation.bounds.segmentDuration);
+        reader.readVector(animation.bounds.segments);
+        reader.read(animation.bounds.clip);
+        consistent = consistent && reader.isValid() && animationInRange(animation);
+    }
+
+    if (!reader.isValid() || !consistent) {
+        std::cout << "WARNING::MODEL_CACHE:: " << cachePath << " is damaged, importing " << sourcePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void ModelCache::apply(Model& model, CookedModel& cooked, const std::string& sourcePath)
+{
+    model.directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+    for (size_t id = 0; id < cooked.boneNames.size(); id++) {
+        model.boneIDMap[cooked.boneNames[id]] = static_cast<int>(id);
+    }
+    for (size_t i = 0; i < cooked.jointNames.size(); i++) {
+        model.skeleton.addJoint(cooked.jointNames[i], cooked.parents[i], cooked.boneIDs[i]);
+        model.skeleton.offsets[i] = cooked.offsets[i];
+    }
+    model.animations = std::move(cooked.animations);
+    if (model.isCharacter) {
+        model.resolveClips();
+    }
+}
+
+bool ModelCache::load(Model& model, const std::string& sourcePath)
+{
+    CookedModel cooked;
+    if (!parse(model.isCharacter, sourcePath, cooked)) return false;
+    apply(model, cooked, sourcePath);
+
+    // Buffers are uploaded straight from the mapping
+    model.meshes.reserve(cooked.meshes.size());
+    for (const CookedMesh& mesh : cooked.meshes) {
+        std::vector<Texture> textures;
+        for (const CookedTexture& texture : mesh.textures) {
+            textures.push_back(model.loadTexture(texture.path, texture.type));
+        }
+        model.meshes.emplace_back(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, std::move(textures));
+    }
+    model.computeMeshBounds(model.meshes);
+    return true;
+}
+
+bool ModelCache::read(Model& model, const std::string& sourcePath)
+{
+    CookedModel cooked;
+    if (!parse(model.isCharacter, sourcePath, cooked)) return false;
+    apply(model, cooked, sourcePath);
+
+    for (const CookedMesh& mesh : cooked.meshes) {
+        MeshData data;
+        data.vertices.assign(mesh.vertices, mesh.vertices + mesh.vertexCount);
+        data.indices.assign(mesh.indices, mesh.indices + mesh.indexCount);
+        for (const CookedTexture& texture : mesh.textures) {
+            Texture reference;
+            reference.id = 0;
+            reference.type = texture.type;
+            reference.path = texture.path;
+            data.textures.push_back(reference);
+        }
+        model.pendingMeshes.push_back(std::move(data));
+    }
+    model.computeMeshBounds(model.pendingMeshes);
+    return true;
+}
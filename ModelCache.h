@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+const uint32_t COOKED_MODEL_MAGIC = 0x4C444D58;  // "XMDL"
+const uint32_t COOKED_MODEL_VERSION = 2;          // Bump whenever anything the cook writes changes layout
+const char* const COOKED_MODEL_EXTENSION = ".cooked";
+
+class Model;
+
+// Cooked binary copy of an imported model, written next to the source file.
+// Holds the vertex and index buffers of every mesh, the bone IDs, the compiled skeleton, every clip with its
+// packed stream and bounds, and the texture references, laid out so loading is a memory map and a walk over it.
+// Vertex and index arrays are handed to glBufferData straight from the mapping.
+class ModelCache
+{
+public:
+    static std::string getCachePath(const std::string& sourcePath);
+
+    // Loads the cooked copy of sourcePath into an empty model. Fails, leaving the model untouched, when there is
+    // no cooked copy or it does not match the source file's size and modification time, this version or this
+    // build's vertex layout. A cooked copy without its source file is used as is.
+    static bool load(Model& model, const std::string& sourcePath);
+
+    // Same without a GL context, for loader threads: the geometry is copied out of the mapping into the
+    // model's pending meshes, which are uploaded later
+    static bool read(Model& model, const std::string& sourcePath);
+
+    // Cooks the model's current state, so clips packed by compressAnimations are stored packed
+    static bool write(const Model& model, const std::string& sourcePath);
+
+private:
+    struct CookedModel;
+
+    static bool parse(bool isCharacter, const std::string& sourcePath, CookedModel& cooked);
+    // Everything but the geometry
+    static void apply(Model& model, CookedModel& cooked, const std::string& sourcePath);
+};
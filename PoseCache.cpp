@@ -0,0 +1,163 @@
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+PoseCache::PoseCache(int boneCount, const PoseCacheSettings& settings) : boneCount(boneCount), settings(settings)
+{
+    size_t paletteBytes = std::max(boneCount, 1) * sizeof(glm::mat4);
+    int capacity = static_cast<int>(std::max<size_t>(settings.budgetBytes / paletteBytes, 1));
+
+    // Keys divide by the quantum, only a positive finite one gives usable steps. Tiny ones are raised so the steps fit.
+    if (std::isfinite(settings.timeQuantum) && settings.timeQuantum > 0.0f) {
+        this->settings.timeQuantum = std::max(settings.timeQuantum, POSE_CACHE_MIN_QUANTUM);
+    }
+    else {
+        this->settings.timeQuantum = PoseCacheSettings().timeQuantum;
+    }
+
+    // Table at most half full keeps the probes short
+    size_t tableSize = 1;
+    while (tableSize < static_cast<size_t>(capacity) * 2) tableSize <<= 1;
+
+    entries.resize(capacity);
+    palettes.resize(static_cast<size_t>(capacity) * boneCount);
+    table.assign(tableSize, POSE_CACHE_NONE);
+    tableMask = tableSize - 1;
+    stats.capacity = capacity;
+    stats.sizeInBytes = entries.size() * sizeof(Entry) + palettes.size() * sizeof(glm::mat4) + table.size() * sizeof(int);
+}
+
+PoseCache::Key PoseCache::makeKey(const Animation& clip, float time) const
+{
+    Key key;
+    key.clip = &clip;
+    key.step = static_cast<int64_t>(std::floor(time / settings.timeQuantum + 0.5f));
+    return key;
+}
+
+bool PoseCache::fetch(const Key& key, glm::mat4* output)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int entry = table[findSlot(key)];
+    if (entry == POSE_CACHE_NONE) {
+        stats.misses++;
+        return false;
+    }
+
+    memcpy(output, &palettes[static_cast<size_t>(entry) * boneCount], boneCount * sizeof(glm::mat4));
+    unlink(entry);
+    pushNewest(entry);
+    stats.hits++;
+    return true;
+}
+
+void PoseCache::store(const Key& key, const glm::mat4* palette)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t slot = findSlot(key);
+    int entry = table[slot];
+
+    if (entry != POSE_CACHE_NONE) {
+        // Another instance evaluated the same key in the meantime
+        unlink(entry);
+    }
+    else {
+        if (entryCount < static_cast<int>(entries.size())) {
+            entry = entryCount++;
+        }
+        else {
+            entry = oldest;
+            unlink(entry);
+            eraseSlot(findSlot(entries[entry].key));
+            stats.evictions++;
+            slot = findSlot(key);  // Erasing may have moved the probe sequence
+        }
+        entries[entry].key = key;
+        table[slot] = entry;
+    }
+
+    memcpy(&palettes[static_cast<size_t>(entry) * boneCount], palette, boneCount * sizeof(glm::mat4));
+    pushNewest(entry);
+}
+
+void PoseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(table.begin(), table.end(), POSE_CACHE_NONE);
+    entryCount = 0;
+    newest = POSE_CACHE_NONE;
+    oldest = POSE_CACHE_NONE;
+}
+
+PoseCacheStats PoseCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    PoseCacheStats current = stats;
+    current.entries = entryCount;
+    return current;
+}
+
+void PoseCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.evictions = 0;
+}
+
+size_t PoseCache::homeSlot(const Key& key) const
+{
+    uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key.clip)) * 0x9E3779B97F4A7C15ull;
+    hash ^= static_cast<uint64_t>(key.step) * 0xC2B2AE3D27D4EB4Full;
+    hash ^= hash >> 29;
+    return static_cast<size_t>(hash) & tableMask;
+}
+
+size_t PoseCache::findSlot(const Key& key) const
+{
+    size_t slot = homeSlot(key);
+    while (table[slot] != POSE_CACHE_NONE && !(entries[table[slot]].key == key)) {
+        slot = (slot + 1) & tableMask;
+    }
+    return slot;
+}
+
+// Backward shift deletion: moves later entries of the probe run into the hole so lookups never stop early
+void PoseCache::eraseSlot(size_t slot)
+{
+    table[slot] = POSE_CACHE_NONE;
+    size_t next = slot;
+    while (true) {
+        next = (next + 1) & tableMask;
+        if (table[next] == POSE_CACHE_NONE) return;
+        size_t home = homeSlot(entries[table[next]].key);
+        bool stays = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+        if (stays) continue;
+        table[slot] = table[next];
+        table[next] = POSE_CACHE_NONE;
+        slot = next;
+    }
+}
+
+void PoseCache::unlink(int entry)
+{
+    Entry& e = entries[entry];
+    if (e.newer != POSE_CACHE_NONE) entries[e.newer].older = e.older;
+    else newest = e.older;
+    if (e.older != POSE_CACHE_NONE) entries[e.older].newer = e.newer;
+    else oldest = e.newer;
+    e.newer = POSE_CACHE_NONE;
+    e.older = POSE_CACHE_NONE;
+}
+
+void PoseCache::pushNewest(int entry)
+{
+    Entry& e = entries[entry];
+    e.newer = POSE_CACHE_NONE;
+    e.older = newest;
+    if (newest != POSE_CACHE_NONE) entries[newest].newer = entry;
+    newest = entry;
+    if (oldest == POSE_CACHE_NONE) oldest = entry;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "Animation.h"
+
+const int POSE_CACHE_NONE = -1;  // Free table slot, or no neighbour in the LRU list
+const float POSE_CACHE_MIN_QUANTUM = 1e-5f;  // Smallest timeQuantum kept, smaller ones are raised to it
+
+struct PoseCacheSettings
+{
+    // Clip times closer than this share one pose, in animation time units. Zero, negative, infinite or NaN use this default.
+    float timeQuantum = 1.0f / 120.0f;
+    size_t budgetBytes = 512 * 1024;    // Palette memory, decides how many poses are kept
+};
+
+struct PoseCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    int entries = 0;
+    int capacity = 0;
+    size_t sizeInBytes = 0;
+
+    double hitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / lookups : 0.0;
+    }
+};
+
+// Bone palettes of one model shared between instances playing the same clip at nearly the same time.
+// Poses are keyed by clip and time rounded to the quantum, and evaluated at the rounded time so every instance
+// on a key sees the same pose. All storage is allocated up front from the budget; once full, the least recently
+// used pose is replaced. Safe to use from the pose update jobs, lookups and stores take a short lock.
+class PoseCache
+{
+public:
+    struct Key
+    {
+        const Animation* clip;
+        int64_t step;  // Time in quanta
+
+        bool operator==(const Key& other) const {
+            return clip == other.clip && step == other.step;
+        }
+    };
+
+    PoseCache(int boneCount, const PoseCacheSettings& settings = PoseCacheSettings());
+
+    Key makeKey(const Animation& clip, float time) const;
+
+    // Time the pose of a key is evaluated at. Kept short of the duration, which getPose would wrap to the first frame.
+    float getKeyTime(const Key& key) const {
+        float time = static_cast<float>(key.step * static_cast<double>(settings.timeQuantum));
+        return std::min(time, std::nextafter(key.clip->duration, 0.0f));
+    }
+
+    // Copies the cached palette into output and returns true on a hit
+    bool fetch(const Key& key, glm::mat4* output);
+    void store(const Key& key, const glm::mat4* palette);
+    void clear();
+
+    PoseCacheStats getStats() const;
+    void resetStats();
+
+    int getBoneCount() const {
+        return boneCount;
+    }
+
+private:
+    struct Entry
+    {
+        Key key;
+        int newer;  // Least recently used list, POSE_CACHE_NONE at the ends
+        int older;
+    };
+
+    int boneCount;
+    PoseCacheSettings settings;
+    mutable std::mutex mutex;
+
+    std::vector<Entry> entries;
+    std::vector<glm::mat4> palettes;  // boneCount matrices per entry
+    std::vector<int> table;           // Open addressing with linear probing, entry index or POSE_CACHE_NONE
+    size_t tableMask = 0;
+    int entryCount = 0;
+    int newest = POSE_CACHE_NONE;
+    int oldest = POSE_CACHE_NONE;
+    PoseCacheStats stats;
+
+    size_t homeSlot(const Key& key) const;
+    size_t findSlot(const Key& key) const;  // Slot holding key, or the empty slot that ends its probe
+    void eraseSlot(size_t slot);
+    void unlink(int entry);
+    void pushNewest(int entry);
+};
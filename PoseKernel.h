@@ -0,0 +1,417 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define POSE_KERNEL_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POSE_KERNEL_SSE
+#endif
+
+// Lane counts are padded to the widest SIMD width so the kernel never needs a scalar tail
+const int POSE_BATCH_PADDING = 8;
+
+// Key pairs and interpolation factors for a batch of joints, stored structure-of-arrays.
+// The sampler gathers keys into this layout, then the kernel interpolates and composes every lane at once.
+struct PoseSamplingBatch
+{
+    enum InputStream
+    {
+        P0X, P0Y, P0Z, P1X, P1Y, P1Z, P_ALPHA,
+        Q0X, Q0Y, Q0Z, Q0W, Q1X, Q1Y, Q1Z, Q1W, Q_ALPHA,
+        S0X, S0Y, S0Z, S1X, S1Y, S1Z, S_ALPHA,
+        INPUT_STREAM_COUNT
+    };
+
+    // Upper 3x4 of the composed local matrix, column-major like glm
+    enum OutputStream
+    {
+        M00, M01, M02, M10, M11, M12, M20, M21, M22, M30, M31, M32,
+        OUTPUT_STREAM_COUNT
+    };
+
+    int count = 0;
+    int capacity = 0;
+    std::vector<float> inputs = {};
+    std::vector<float> outputs = {};
+
+    void resize(int laneCount)
+    {
+        count = laneCount;
+        capacity = (laneCount + POSE_BATCH_PADDING - 1) / POSE_BATCH_PADDING * POSE_BATCH_PADDING;
+        inputs.assign(static_cast<size_t>(INPUT_STREAM_COUNT) * capacity, 0.0f);
+        outputs.assign(static_cast<size_t>(OUTPUT_STREAM_COUNT) * capacity, 0.0f);
+
+        // Identity rotation and unit scale, so padding lanes stay well defined
+        for (int lane = 0; lane < capacity; lane++) {
+            setIdentityKeys(lane);
+        }
+    }
+
+    // Key pair slot 0 or 1 of a stream group, for kernels that write sampled poses back into a batch
+    static InputStream keyStream(InputStream first, int slot)
+    {
+        int stride = first == Q0X ? 4 : 3;
+        return static_cast<InputStream>(first + slot * stride);
+    }
+
+    float* input(InputStream stream) { return inputs.data() + static_cast<size_t>(stream) * capacity; }
+    const float* input(InputStream stream) const { return inputs.data() + static_cast<size_t>(stream) * capacity; }
+    float* output(OutputStream stream) { return outputs.data() + static_cast<size_t>(stream) * capacity; }
+    const float* output(OutputStream stream) const { return outputs.data() + static_cast<size_t>(stream) * capacity; }
+
+    void setPositionKeys(int lane, const glm::vec3& a, const glm::vec3& b, float alpha)
+    {
+        input(P0X)[lane] = a.x; input(P0Y)[lane] = a.y; input(P0Z)[lane] = a.z;
+        input(P1X)[lane] = b.x; input(P1Y)[lane] = b.y; input(P1Z)[lane] = b.z;
+        input(P_ALPHA)[lane] = alpha;
+    }
+
+    void setRotationKeys(int lane, const glm::quat& a, const glm::quat& b, float alpha)
+    {
+        input(Q0X)[lane] = a.x; input(Q0Y)[lane] = a.y; input(Q0Z)[lane] = a.z; input(Q0W)[lane] = a.w;
+        input(Q1X)[lane] = b.x; input(Q1Y)[lane] = b.y; input(Q1Z)[lane] = b.z; input(Q1W)[lane] = b.w;
+        input(Q_ALPHA)[lane] = alpha;
+    }
+
+    void setScaleKeys(int lane, const glm::vec3& a, const glm::vec3& b, float alpha)
+    {
+        input(S0X)[lane] = a.x; input(S0Y)[lane] = a.y; input(S0Z)[lane] = a.z;
+        input(S1X)[lane] = b.x; input(S1Y)[lane] = b.y; input(S1Z)[lane] = b.z;
+        input(S_ALPHA)[lane] = alpha;
+    }
+
+    void setIdentityKeys(int lane)
+    {
+        setPositionKeys(lane, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
+        setRotationKeys(lane, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 0.0f);
+        setScaleKeys(lane, glm::vec3(1.0f), glm::vec3(1.0f), 0.0f);
+    }
+
+    // Same interpolation factor for every track of every lane, used to blend two sampled poses
+    void setBlendWeight(float alpha)
+    {
+        std::fill(input(P_ALPHA), input(P_ALPHA) + capacity, alpha);
+        std::fill(input(Q_ALPHA), input(Q_ALPHA) + capacity, alpha);
+        std::fill(input(S_ALPHA), input(S_ALPHA) + capacity, alpha);
+    }
+
+    glm::mat4 getLocalTransform(int lane) const
+    {
+        glm::mat4 m(1.0f);
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                m[column][row] = output(static_cast<OutputStream>(column * 3 + row))[lane];
+            }
+        }
+        return m;
+    }
+};
+
+namespace PoseKernel
+{
+    // Thin wrappers with the same interface for every instruction set, so the kernel is written once
+    struct ScalarLanes
+    {
+        static const int WIDTH = 1;
+        float v;
+
+        static ScalarLanes load(const float* p) { return { *p }; }
+        static ScalarLanes set(float x) { return { x }; }
+        static ScalarLanes gather(const float* base, const int* offsets) { return { base[offsets[0]] }; }
+        void store(float* p) const { *p = v; }
+        friend ScalarLanes operator+(ScalarLanes a, ScalarLanes b) { return { a.v + b.v }; }
+        friend ScalarLanes operator-(ScalarLanes a, ScalarLanes b) { return { a.v - b.v }; }
+        friend ScalarLanes operator*(ScalarLanes a, ScalarLanes b) { return { a.v * b.v }; }
+        friend ScalarLanes operator/(ScalarLanes a, ScalarLanes b) { return { a.v / b.v }; }
+        friend ScalarLanes abs(ScalarLanes a) { return { std::fabs(a.v) }; }
+        friend ScalarLanes inverseSqrt(ScalarLanes a) { return { 1.0f / std::sqrt(a.v) }; }
+        // Negates x in the lanes where sign is negative
+        friend ScalarLanes flipSign(ScalarLanes x, ScalarLanes sign) { return { sign.v < 0.0f ? -x.v : x.v }; }
+    };
+
+#ifdef POSE_KERNEL_SSE
+    struct SseLanes
+    {
+        static const int WIDTH = 4;
+        __m128 v;
+
+        static SseLanes load(const float* p) { return { _mm_loadu_ps(p) }; }
+        static SseLanes set(float x) { return { _mm_set1_ps(x) }; }
+        static SseLanes gather(const float* base, const int* offsets) { return { _mm_set_ps(base[offsets[3]], base[offsets[2]], base[offsets[1]], base[offsets[0]]) }; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+        friend SseLanes operator+(SseLanes a, SseLanes b) { return { _mm_add_ps(a.v, b.v) }; }
+        friend SseLanes operator-(SseLanes a, SseLanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+        friend SseLanes operator*(SseLanes a, SseLanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+        friend SseLanes operator/(SseLanes a, SseLanes b) { return { _mm_div_ps(a.v, b.v) }; }
+        friend SseLanes abs(SseLanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+        friend SseLanes inverseSqrt(SseLanes a) { return { _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a.v)) }; }
+        friend SseLanes flipSign(SseLanes x, SseLanes sign) { return { _mm_xor_ps(x.v, _mm_and_ps(sign.v, _mm_set1_ps(-0.0f))) }; }
+    };
+#endif
+
+#ifdef POSE_KERNEL_AVX2
+    struct Avx2Lanes
+    {
+        static const int WIDTH = 8;
+        __m256 v;
+
+        static Avx2Lanes load(const float* p) { return { _mm256_loadu_ps(p) }; }
+        static Avx2Lanes set(float x) { return { _mm256_set1_ps(x) }; }
+        static Avx2Lanes gather(const float* base, const int* offsets) { return { _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets)), 4) }; }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+        friend Avx2Lanes operator+(Avx2Lanes a, Avx2Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+        friend Avx2Lanes operator-(Avx2Lanes a, Avx2Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+        friend Avx2Lanes operator*(Avx2Lanes a, Avx2Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+        friend Avx2Lanes operator/(Avx2Lanes a, Avx2Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+        friend Avx2Lanes abs(Avx2Lanes a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+        friend Avx2Lanes inverseSqrt(Avx2Lanes a) { return { _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(a.v)) }; }
+        friend Avx2Lanes flipSign(Avx2Lanes x, Avx2Lanes sign) { return { _mm256_xor_ps(x.v, _mm256_and_ps(sign.v, _mm256_set1_ps(-0.0f))) }; }
+    };
+#endif
+
+    template <typename V>
+    inline V lerpLanes(V a, V b, V alpha)
+    {
+        return a + (b - a) * alpha;
+    }
+
+    // Local pose of a group of lanes: translation, rotation quaternion and scale
+    template <typename V>
+    struct LanePose
+    {
+        V px, py, pz;
+        V qx, qy, qz, qw;
+        V sx, sy, sz;
+    };
+
+    // Interpolates the key pairs of lanes [i, i + V::WIDTH).
+    // Rotations use nlerp with a polynomial correction of the interpolation factor, which keeps the
+    // result within about 1e-3 radians of slerp for any key pair and about 2e-5 radians for neighbouring
+    // keys, at the cost of a few multiplies and no trigonometry.
+    template <typename V>
+    inline LanePose<V> interpolateLanes(const PoseSamplingBatch& batch, int i)
+    {
+        typedef PoseSamplingBatch B;
+        const V one = V::set(1.0f);
+        const V half = V::set(0.5f);
+        LanePose<V> pose;
+
+        // Position and scale: plain lerp
+        V alpha = V::load(batch.input(B::P_ALPHA) + i);
+        pose.px = lerpLanes(V::load(batch.input(B::P0X) + i), V::load(batch.input(B::P1X) + i), alpha);
+        pose.py = lerpLanes(V::load(batch.input(B::P0Y) + i), V::load(batch.input(B::P1Y) + i), alpha);
+        pose.pz = lerpLanes(V::load(batch.input(B::P0Z) + i), V::load(batch.input(B::P1Z) + i), alpha);
+
+        alpha = V::load(batch.input(B::S_ALPHA) + i);
+        pose.sx = lerpLanes(V::load(batch.input(B::S0X) + i), V::load(batch.input(B::S1X) + i), alpha);
+        pose.sy = lerpLanes(V::load(batch.input(B::S0Y) + i), V::load(batch.input(B::S1Y) + i), alpha);
+        pose.sz = lerpLanes(V::load(batch.input(B::S0Z) + i), V::load(batch.input(B::S1Z) + i), alpha);
+
+        // Rotation: corrected nlerp along the shortest arc
+        V ax = V::load(batch.input(B::Q0X) + i);
+        V ay = V::load(batch.input(B::Q0Y) + i);
+        V az = V::load(batch.input(B::Q0Z) + i);
+        V aw = V::load(batch.input(B::Q0W) + i);
+        V bx = V::load(batch.input(B::Q1X) + i);
+        V by = V::load(batch.input(B::Q1Y) + i);
+        V bz = V::load(batch.input(B::Q1Z) + i);
+        V bw = V::load(batch.input(B::Q1W) + i);
+        V t = V::load(batch.input(B::Q_ALPHA) + i);
+
+        V cosine = ax * bx + ay * by + az * bz + aw * bw;
+        V d = abs(cosine);
+        V k = V::set(1.0904f) + d * (V::set(-3.2452f) + d * (V::set(3.55645f) - d * V::set(1.43519f)));
+        V b2 = V::set(0.848013f) + d * (V::set(-1.06021f) + d * V::set(0.215638f));
+        V tc = t - half;
+        k = k * tc * tc + b2;
+        t = t + t * tc * (t - one) * k;
+
+        V ta = one - t;
+        V tb = flipSign(t, cosine);
+        V qx = ax * ta + bx * tb;
+        V qy = ay * ta + by * tb;
+        V qz = az * ta + bz * tb;
+        V qw = aw * ta + bw * tb;
+        V invLength = inverseSqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+        pose.qx = qx * invLength;
+        pose.qy = qy * invLength;
+        pose.qz = qz * invLength;
+        pose.qw = qw * invLength;
+        return pose;
+    }
+
+    // Interpolates and composes lanes [begin, end) of the batch into local TRS matrices
+    template <typename V>
+    inline void composeLanes(PoseSamplingBatch& batch, int begin, int end)
+    {
+        typedef PoseSamplingBatch B;
+        const V one = V::set(1.0f);
+        const V two = V::set(2.0f);
+
+        for (int i = begin; i < end; i += V::WIDTH) {
+            LanePose<V> pose = interpolateLanes<V>(batch, i);
+            V sx = pose.sx, sy = pose.sy, sz = pose.sz;
+
+            // TRS built directly: rotation columns scaled by s, translation in the last column
+            V xx = pose.qx * pose.qx, yy = pose.qy * pose.qy, zz = pose.qz * pose.qz;
+            V xy = pose.qx * pose.qy, xz = pose.qx * pose.qz, yz = pose.qy * pose.qz;
+            V wx = pose.qw * pose.qx, wy = pose.qw * pose.qy, wz = pose.qw * pose.qz;
+
+            ((one - two * (yy + zz)) * sx).store(batch.output(B::M00) + i);
+            (two * (xy + wz) * sx).store(batch.output(B::M01) + i);
+            (two * (xz - wy) * sx).store(batch.output(B::M02) + i);
+            (two * (xy - wz) * sy).store(batch.output(B::M10) + i);
+            ((one - two * (xx + zz)) * sy).store(batch.output(B::M11) + i);
+            (two * (yz + wx) * sy).store(batch.output(B::M12) + i);
+            (two * (xz + wy) * sz).store(batch.output(B::M20) + i);
+            (two * (yz - wx) * sz).store(batch.output(B::M21) + i);
+            ((one - two * (xx + yy)) * sz).store(batch.output(B::M22) + i);
+            pose.px.store(batch.output(B::M30) + i);
+            pose.py.store(batch.output(B::M31) + i);
+            pose.pz.store(batch.output(B::M32) + i);
+        }
+    }
+
+    // Interpolates the key pairs of source and stores the sampled poses as key slot 0 or 1 of target.
+    // Source and target may be the same batch, every group of lanes is read before it is written.
+    template <typename V>
+    inline void sampleLanes(const PoseSamplingBatch& source, PoseSamplingBatch& target, int slot, int begin, int end)
+    {
+        typedef PoseSamplingBatch B;
+        float* p = target.input(B::keyStream(B::P0X, slot));
+        float* q = target.input(B::keyStream(B::Q0X, slot));
+        float* s = target.input(B::keyStream(B::S0X, slot));
+        const int stride = target.capacity;
+
+        for (int i = begin; i < end; i += V::WIDTH) {
+            LanePose<V> pose = interpolateLanes<V>(source, i);
+            pose.px.store(p + i);
+            pose.py.store(p + stride + i);
+            pose.pz.store(p + 2 * stride + i);
+            pose.qx.store(q + i);
+            pose.qy.store(q + stride + i);
+            pose.qz.store(q + 2 * stride + i);
+            pose.qw.store(q + 3 * stride + i);
+            pose.sx.store(s + i);
+            pose.sy.store(s + stride + i);
+            pose.sz.store(s + 2 * stride + i);
+        }
+    }
+
+    // Adds the difference between the layer and reference poses (key slot 0 of each), scaled by weight, to
+    // key slot 0 of target. Translation adds, rotation is post-multiplied by the partial delta rotation and
+    // scale is multiplied by the partial scale ratio.
+    template <typename V>
+    inline void addLanes(PoseSamplingBatch& target, const PoseSamplingBatch& layer, const PoseSamplingBatch& reference, float weight, int begin, int end)
+    {
+        typedef PoseSamplingBatch B;
+        const V one = V::set(1.0f);
+        const V w = V::set(weight);
+        const V rest = V::set(1.0f - weight);
+
+        for (int i = begin; i < end; i += V::WIDTH) {
+            for (int axis = 0; axis < 3; axis++) {
+                B::InputStream ps = static_cast<B::InputStream>(B::P0X + axis);
+                B::InputStream ss = static_cast<B::InputStream>(B::S0X + axis);
+                V delta = V::load(layer.input(ps) + i) - V::load(reference.input(ps) + i);
+                (V::load(target.input(ps) + i) + delta * w).store(target.input(ps) + i);
+                V ratio = V::load(layer.input(ss) + i) / V::load(reference.input(ss) + i);
+                (V::load(target.input(ss) + i) * (one + (ratio - one) * w)).store(target.input(ss) + i);
+            }
+
+            // Delta rotation conjugate(reference) * layer
+            V rx = V::load(reference.input(B::Q0X) + i);
+            V ry = V::load(reference.input(B::Q0Y) + i);
+            V rz = V::load(reference.input(B::Q0Z) + i);
+            V rw = V::load(reference.input(B::Q0W) + i);
+            V lx = V::load(layer.input(B::Q0X) + i);
+            V ly = V::load(layer.input(B::Q0Y) + i);
+            V lz = V::load(layer.input(B::Q0Z) + i);
+            V lw = V::load(layer.input(B::Q0W) + i);
+            V dw = rw * lw + rx * lx + ry * ly + rz * lz;
+            V dx = rw * lx - rx * lw - ry * lz + rz * ly;
+            V dy = rw * ly + rx * lz - ry * lw - rz * lx;
+            V dz = rw * lz - rx * ly + ry * lx - rz * lw;
+
+            // nlerp from identity along the shortest arc
+            V tb = flipSign(w, dw);
+            dx = dx * tb;
+            dy = dy * tb;
+            dz = dz * tb;
+            dw = rest + dw * tb;
+            V invLength = inverseSqrt(dx * dx + dy * dy + dz * dz + dw * dw);
+            dx = dx * invLength;
+            dy = dy * invLength;
+            dz = dz * invLength;
+            dw = dw * invLength;
+
+            // target * delta
+            V ax = V::load(target.input(B::Q0X) + i);
+            V ay = V::load(target.input(B::Q0Y) + i);
+            V az = V::load(target.input(B::Q0Z) + i);
+            V aw = V::load(target.input(B::Q0W) + i);
+            (aw * dx + ax * dw + ay * dz - az * dy).store(target.input(B::Q0X) + i);
+            (aw * dy - ax * dz + ay * dw + az * dx).store(target.input(B::Q0Y) + i);
+            (aw * dz + ax * dy - ay * dx + az * dw).store(target.input(B::Q0Z) + i);
+            (aw * dw - ax * dx - ay * dy - az * dz).store(target.input(B::Q0W) + i);
+        }
+    }
+
+    inline void composeLocalTransformsScalar(PoseSamplingBatch& batch)
+    {
+        composeLanes<ScalarLanes>(batch, 0, batch.count);
+    }
+
+    // Widest kernel this build supports
+    inline void composeLocalTransforms(PoseSamplingBatch& batch)
+    {
+#if defined(POSE_KERNEL_AVX2)
+        composeLanes<Avx2Lanes>(batch, 0, batch.capacity);
+#elif defined(POSE_KERNEL_SSE)
+        composeLanes<SseLanes>(batch, 0, batch.capacity);
+#else
+        composeLocalTransformsScalar(batch);
+#endif
+    }
+
+    inline void sampleLocalPoses(const PoseSamplingBatch& source, PoseSamplingBatch& target, int slot)
+    {
+#if defined(POSE_KERNEL_AVX2)
+        sampleLanes<Avx2Lanes>(source, target, slot, 0, source.capacity);
+#elif defined(POSE_KERNEL_SSE)
+        sampleLanes<SseLanes>(source, target, slot, 0, source.capacity);
+#else
+        sampleLanes<ScalarLanes>(source, target, slot, 0, source.count);
+#endif
+    }
+
+    inline void addLocalPoses(PoseSamplingBatch& target, const PoseSamplingBatch& layer, const PoseSamplingBatch& reference, float weight)
+    {
+#if defined(POSE_KERNEL_AVX2)
+        addLanes<Avx2Lanes>(target, layer, reference, weight, 0, target.capacity);
+#elif defined(POSE_KERNEL_SSE)
+        addLanes<SseLanes>(target, layer, reference, weight, 0, target.capacity);
+#else
+        addLanes<ScalarLanes>(target, layer, reference, weight, 0, target.count);
+#endif
+    }
+
+    inline const char* instructionSet()
+    {
+#if defined(POSE_KERNEL_AVX2)
+        return "AVX2";
+#elif defined(POSE_KERNEL_SSE)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+// Positions and normals come from the instance's pre-skinned buffer, texture coordinates from the mesh
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+
+    // Pass texture coordinates
+    TexCoords = aTexCoords;
+
+    // Transform normal for lighting calculations
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+
+    // Pass transformed fragment position
+    FragPos = vec3(model * vec4(aPos, 1.0));
+}
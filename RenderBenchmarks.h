@@ -0,0 +1,490 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BonePalette.h"
+#include "Model.h"
+#include "AnimationInstance.h"
+#include "SkinningFeedback.h"
+#include "SkinningKernel.h"
+#include "AnimationBaker.h"
+#include "CrowdBatch.h"
+#include "MappedFile.h"
+#include "AssetLoader.h"
+
+// Microbenchmarks for the render path. Unlike AnimationBenchmarks these need a current OpenGL context.
+namespace RenderBenchmarks
+{
+    inline GLuint compileProgram(const std::string& vertexSource, const std::string& fragmentSource)
+    {
+        const char* sources[] = { vertexSource.c_str(), fragmentSource.c_str() };
+        const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+        GLuint program = glCreateProgram();
+        for (int i = 0; i < 2; i++) {
+            GLuint shader = glCreateShader(types[i]);
+            glShaderSource(shader, 1, &sources[i], NULL);
+            glCompileShader(shader);
+            GLint success;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                GLchar infoLog[1024];
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::BENCHMARK::SHADER_COMPILATION_ERROR\n" << infoLog << std::endl;
+            }
+            glAttachShader(program, shader);
+            glDeleteShader(shader);
+        }
+        glLinkProgram(program);
+        return program;
+    }
+
+    // CPU time of one draw including its palette upload, averaged over draws. The GPU work is waited for outside the timing.
+    template <typename Upload>
+    inline double measureDrawMicroseconds(GLuint program, int draws, Upload&& upload)
+    {
+        glUseProgram(program);
+        glFinish();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < draws; i++) {
+            upload();
+            glDrawArrays(GL_POINTS, 0, MAX_BONES);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        glFinish();
+        return std::chrono::duration<double, std::micro>(end - start).count() / draws;
+    }
+
+    // Compares the bone palette upload paths on a minimal skinned draw:
+    // one glGetUniformLocation and glUniformMatrix4fv per bone through a built name (the old updateBoneTransformations),
+    // one glUniformMatrix4fv with a count, and the BonePalette uniform block
+    inline void runBonePaletteBenchmark(int draws = 2000)
+    {
+        const std::string header = "#version 330 core\n#define MAX_BONES " + std::to_string(MAX_BONES) + "\n";
+        const std::string body = "void main() { gl_Position = bones[gl_VertexID] * vec4(0.0, 0.0, 0.0, 1.0); }\n";
+        const std::string fragment = "#version 330 core\nout vec4 color;\nvoid main() { color = vec4(1.0); }\n";
+        GLuint arrayProgram = compileProgram(header + "uniform mat4 bones[MAX_BONES];\n" + body, fragment);
+        GLuint blockProgram = compileProgram(header + "layout(std140) uniform BonePalette { mat4 bones[MAX_BONES]; };\n" + body, fragment);
+
+        GLuint vao;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        std::vector<glm::mat4> palette(MAX_BONES);
+        for (int i = 0; i < MAX_BONES; i++) {
+            palette[i] = glm::translate(glm::mat4(1.0f), glm::vec3(i * 0.001f, 0.0f, 0.0f));
+        }
+
+        double namedUs = measureDrawMicroseconds(arrayProgram, draws, [&]() {
+            for (unsigned int i = 0; i < palette.size(); i++) {
+                std::string name = "bones[" + std::to_string(i) + "]";
+                glUniformMatrix4fv(glGetUniformLocation(arrayProgram, name.c_str()), 1, GL_FALSE, &palette[i][0][0]);
+            }
+        });
+        BonePalette arrayPalette;
+        double arrayUs = measureDrawMicroseconds(arrayProgram, draws, [&]() {
+            arrayPalette.upload(arrayProgram, palette.data(), MAX_BONES);
+        });
+        BonePalette blockPalette;
+        double blockUs = measureDrawMicroseconds(blockProgram, draws, [&]() {
+            blockPalette.upload(blockProgram, palette.data(), MAX_BONES);
+        });
+        OpenGLErrors::checkOpenGLError("RenderBenchmarks::runBonePaletteBenchmark");
+
+        std::cout << "BENCHMARK::BONE_PALETTE:: " << MAX_BONES << " bones, CPU time per draw"
+            << " named uniforms: " << namedUs << " us"
+            << " single glUniformMatrix4fv: " << arrayUs << " us"
+            << " uniform block: " << blockUs << " us"
+            << " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+
+        arrayPalette.release();
+        blockPalette.release();
+        glDeleteVertexArrays(1, &vao);
+        glDeleteProgram(arrayProgram);
+        glDeleteProgram(blockProgram);
+    }
+
+    // Draws a posed character in several passes per frame, once re-skinning in every pass and once pre-skinned by
+    // transform feedback and drawn as a static mesh. The captured vertices are checked against the CPU skinning kernel.
+    // Both shaders need their view and projection set; the frame time includes waiting for the GPU.
+    inline void runPreSkinningBenchmark(Model& model, Shader& skinningShader, Shader& preSkinnedShader, SkinningFeedback& feedback,
+        int passes = 3, int frames = 100)
+    {
+        if (!model.hasSkeleton() || !feedback.isValid()) {
+            std::cout << "BENCHMARK::PRE_SKINNING:: Needs a skinned model and valid feedback programs." << std::endl;
+            return;
+        }
+
+        AnimationInstance instance(&model);
+        std::vector<glm::mat4> palette(model.getBoneCount(), glm::mat4(1.0f));
+        const Animation& animation = model.getAnimations().begin()->second;
+        instance.getPose(animation, animation.duration * 0.37f, palette, glm::mat4(1.0f));
+        int paletteSize = static_cast<int>(palette.size());
+
+        PreSkinnedBuffers buffers;
+        feedback.begin();
+        feedback.skin(model, palette.data(), paletteSize, buffers);
+        feedback.end();
+
+        // Compare with the CPU kernel, linear blend models only
+        float positionError = 0.0f;
+        float normalError = 0.0f;
+        if (model.getSkinningMode() == LINEAR_BLEND_SKINNING) {
+            SkinningInput input;
+            SkinnedVertices expected;
+            std::vector<float> captured;
+            for (size_t m = 0; m < model.meshes.size(); m++) {
+                input.build(model.meshes[m].vertices);
+                SkinningKernel::skinVertices(input, palette.data(), expected);
+                captured.resize(static_cast<size_t>(input.count) * 6);
+                glBindBuffer(GL_ARRAY_BUFFER, buffers.getSkinnedVertexBuffer(m));
+                glGetBufferSubData(GL_ARRAY_BUFFER, 0, captured.size() * sizeof(float), captured.data());
+                for (int i = 0; i < input.count; i++) {
+                    glm::vec3 position(captured[i * 6], captured[i * 6 + 1], captured[i * 6 + 2]);
+                    glm::vec3 normal(captured[i * 6 + 3], captured[i * 6 + 4], captured[i * 6 + 5]);
+                    positionError = std::max(positionError, glm::length(position - expected.getPosition(i)));
+                    normalError = std::max(normalError, glm::length(normal - expected.getNormal(i)) / std::max(glm::length(expected.getNormal(i)), 1e-6f));
+                }
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        auto measureFrames = [&](auto&& frame) {
+            glFinish();
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int f = 0; f < frames; f++) {
+                frame();
+            }
+            glFinish();
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+        };
+        glm::mat4 identity(1.0f);
+
+        double skinnedMs = measureFrames([&]() {
+            skinningShader.use();
+            skinningShader.setMat4("model", identity);
+            for (int p = 0; p < passes; p++) {
+                updateBoneTransformations(skinningShader, palette.data(), paletteSize);
+                model.Draw(skinningShader);
+            }
+        });
+        double preSkinnedMs = measureFrames([&]() {
+            feedback.begin();
+            feedback.skin(model, palette.data(), paletteSize, buffers);
+            feedback.end();
+            preSkinnedShader.use();
+            preSkinnedShader.setMat4("model", identity);
+            for (int p = 0; p < passes; p++) {
+                buffers.Draw(model, preSkinnedShader);
+            }
+        });
+        OpenGLErrors::checkOpenGLError("RenderBenchmarks::runPreSkinningBenchmark");
+
+        std::cout << "BENCHMARK::PRE_SKINNING:: " << passes << " passes per frame"
+            << " skinning every pass: " << skinnedMs << " ms/frame"
+            << " pre-skinned: " << preSkinnedMs << " ms/frame"
+            << " buffer: " << buffers.getSizeInBytes() << " bytes";
+        if (model.getSkinningMode() == LINEAR_BLEND_SKINNING) {
+            std::cout << " vs CPU kernel position max: " << positionError << " normal max (relative): " << normalError;
+        }
+        std::cout << " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+    }
+
+    // Bakes every clip of the model, measures how far the frame-interpolated palettes drift from live getPose,
+    // and draws a crowd of characters instanced from the baked texture against the CPU pose time it replaces.
+    // The crowd shader needs its view and projection set.
+    inline void runBakedCrowdBenchmark(const Model& model, Shader& crowdShader, int characters = 1000, int frames = 50, float sampleRate = 30.0f)
+    {
+        BakedAnimationTexture baked;
+        auto bakeStart = std::chrono::high_resolution_clock::now();
+        bool ok = baked.bake(model, sampleRate) && baked.upload();
+        auto bakeEnd = std::chrono::high_resolution_clock::now();
+        if (!ok) {
+            std::cout << "BENCHMARK::BAKED_CROWD:: Model could not be baked." << std::endl;
+            return;
+        }
+
+        // Halfway between baked frames is where interpolation drifts the most
+        AnimationInstance instance(&model);
+        std::vector<glm::mat4> live(model.getBoneCount(), glm::mat4(1.0f));
+        float maxError = 0.0f;
+        for (const BakedClip& clip : baked.getClips()) {
+            const Animation& animation = model.getAnimations().at(clip.name);
+            for (int frame = 0; frame + 1 < clip.frameCount; frame++) {
+                float time = clip.duration * (frame + 0.5f) / (clip.frameCount - 1);
+                instance.getPose(animation, time, live, glm::mat4(1.0f));
+                for (int bone = 0; bone < baked.getBoneCount(); bone++) {
+                    glm::mat4 a = baked.getBoneTransform(clip.firstFrame + frame, bone);
+                    glm::mat4 b = baked.getBoneTransform(clip.firstFrame + frame + 1, bone);
+                    for (int c = 0; c < 4; c++) {
+                        maxError = std::max(maxError, glm::length(glm::mix(a[c], b[c], 0.5f) - live[bone][c]));
+                    }
+                }
+            }
+        }
+
+        // A grid of characters, each on some clip at its own phase
+        std::vector<CrowdInstance> instances(characters);
+        int side = std::max(static_cast<int>(std::sqrt(static_cast<float>(characters))), 1);
+        for (int i = 0; i < characters; i++) {
+            instances[i].model = glm::translate(glm::mat4(1.0f), glm::vec3((i % side) * 2.0f, 0.0f, -(i / side) * 2.0f));
+            instances[i].clip = i % static_cast<int>(baked.getClips().size());
+            instances[i].timeOffset = i * 0.137f;
+        }
+        CrowdBatch crowd;
+        crowd.setInstances(model, instances);
+
+        crowdShader.use();
+        glFinish();
+        auto drawStart = std::chrono::high_resolution_clock::now();
+        for (int f = 0; f < frames; f++) {
+            crowd.Draw(crowdShader, baked, f / 60.0f);
+        }
+        glFinish();
+        auto drawEnd = std::chrono::high_resolution_clock::now();
+        OpenGLErrors::checkOpenGLError("RenderBenchmarks::runBakedCrowdBenchmark");
+
+        // The CPU work the baked crowd skips: one pose evaluation per character per frame
+        const Animation& animation = model.getAnimations().begin()->second;
+        auto poseStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < characters; i++) {
+            instance.getPose(animation, i * 0.137f, live, glm::mat4(1.0f));
+        }
+        auto poseEnd = std::chrono::high_resolution_clock::now();
+
+        std::cout << "BENCHMARK::BAKED_CROWD:: " << baked.getClips().size() << " clips, " << baked.getRowCount() << " frames of "
+            << baked.getBoneCount() << " bones baked in " << std::chrono::duration<double, std::milli>(bakeEnd - bakeStart).count() << " ms"
+            << " texture: " << baked.getSizeInBytes() << " bytes"
+            << " mid-frame error vs live pose: " << maxError << std::endl;
+        std::cout << "BENCHMARK::BAKED_CROWD:: " << characters << " characters"
+            << " instanced draw: " << std::chrono::duration<double, std::milli>(drawEnd - drawStart).count() / frames << " ms/frame"
+            << " CPU animation: 0 ms/frame instead of " << std::chrono::duration<double, std::milli>(poseEnd - poseStart).count() << " ms/frame"
+            << " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+    }
+
+    // Load time of a model from its source file through Assimp against the cooked copy. Cold is the first load,
+    // which imports and cooks; warm maps the cooked file. Deletes and rewrites the cooked copy.
+    inline void runModelLoadBenchmark(const std::string& path, bool isCharacter)
+    {
+        std::remove(ModelCache::getCachePath(path).c_str());
+
+        auto importStart = std::chrono::high_resolution_clock::now();
+        Model imported(path, isCharacter, false, false);
+        auto importEnd = std::chrono::high_resolution_clock::now();
+
+        auto coldStart = std::chrono::high_resolution_clock::now();
+        Model cold(path, isCharacter);
+        auto coldEnd = std::chrono::high_resolution_clock::now();
+
+        auto warmStart = std::chrono::high_resolution_clock::now();
+        Model warm(path, isCharacter);
+        auto warmEnd = std::chrono::high_resolution_clock::now();
+
+        size_t importedVertices = 0;
+        size_t warmVertices = 0;
+        for (const Mesh& mesh : imported.meshes) importedVertices += mesh.vertices.size();
+        for (const Mesh& mesh : warm.meshes) warmVertices += mesh.vertices.size();
+        bool matches = importedVertices == warmVertices && imported.meshes.size() == warm.meshes.size()
+            && imported.getBoneCount() == warm.getBoneCount() && imported.getSkeleton().size() == warm.getSkeleton().size()
+            && imported.getClipCount() == warm.getClipCount();
+
+        uint64_t cookedSize = 0;
+        int64_t cookedTime;
+        getFileStamp(ModelCache::getCachePath(path), cookedSize, cookedTime);
+
+        std::cout << "BENCHMARK::MODEL_LOAD:: " << path << " " << warm.meshes.size() << " meshes, " << warmVertices << " vertices, "
+            << warm.getClipCount() << " clips, cooked: " << cookedSize << " bytes" << (matches ? "" : " MISMATCH") << std::endl;
+        std::cout << "BENCHMARK::MODEL_LOAD:: Assimp: " << std::chrono::duration<double, std::milli>(importEnd - importStart).count() << " ms"
+            << " cold (import + cook): " << std::chrono::duration<double, std::milli>(coldEnd - coldStart).count() << " ms"
+            << " warm (cooked): " << std::chrono::duration<double, std::milli>(warmEnd - warmStart).count() << " ms" << std::endl;
+    }
+
+    // Main thread cost of loading count copies of a model synchronously against the AssetLoader: the sync load
+    // stalls for the whole time, the async one only for the budgeted uploads of each frame
+    inline void runAsyncLoadBenchmark(const std::string& path, bool isCharacter, int count, float budgetMilliseconds = DEFAULT_UPLOAD_BUDGET_MS)
+    {
+        auto syncStart = std::chrono::high_resolution_clock::now();
+        {
+            std::vector<std::unique_ptr<Model>> models;
+            for (int i = 0; i < count; i++) {
+                models.push_back(std::unique_ptr<Model>(new Model(path, isCharacter)));
+            }
+        }
+        auto syncEnd = std::chrono::high_resolution_clock::now();
+
+        AssetLoader loader;
+        std::vector<std::unique_ptr<Model>> models;
+        auto asyncStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; i++) {
+            models.push_back(std::unique_ptr<Model>(new Model(path, isCharacter, loader)));
+        }
+        int frames = 0;
+        double worstFrame = 0.0;
+        while (loader.getPendingCount() > 0) {
+            auto frameStart = std::chrono::high_resolution_clock::now();
+            loader.update(budgetMilliseconds);
+            auto frameEnd = std::chrono::high_resolution_clock::now();
+            worstFrame = std::max(worstFrame, std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+            frames++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));  // Stands in for the rest of the frame
+        }
+        auto asyncEnd = std::chrono::high_resolution_clock::now();
+
+        int ready = 0;
+        for (const std::unique_ptr<Model>& model : models) {
+            ready += model->isReady() ? 1 : 0;
+        }
+        std::cout << "BENCHMARK::ASYNC_LOAD:: " << count << " x " << path << " sync: "
+            << std::chrono::duration<double, std::milli>(syncEnd - syncStart).count() << " ms on the main thread" << std::endl;
+        std::cout << "BENCHMARK::ASYNC_LOAD:: async: " << ready << "/" << count << " ready after " << frames << " frames, "
+            << std::chrono::duration<double, std::milli>(asyncEnd - asyncStart).count() << " ms, worst main thread update: "
+            << worstFrame << " ms (budget " << budgetMilliseconds << " ms)" << std::endl;
+    }
+
+    // Raw decode and upload with glGenerateMipmap against the cooked path: first load compresses and writes the KTX,
+    // later loads upload its blocks directly. The error is the RMSE of level 0 over the channels the format keeps.
+    inline void runTextureCompressionBenchmark(const std::string& filename, TextureUsage usage = TEXTURE_COLOR)
+    {
+        bool wasCooking = isTextureCookingEnabled();
+        std::remove((filename + COOKED_TEXTURE_EXTENSION).c_str());
+
+        auto loadTexture = [&](bool cooking, double& milliseconds) {
+            setTextureCooking(cooking);
+            auto start = std::chrono::high_resolution_clock::now();
+            TextureImage image;
+            decodeTextureImage(filename, image, usage);
+            GLuint texture = uploadTextureImage(image);
+            glFinish();
+            milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            glDeleteTextures(1, &texture);
+        };
+        double rawMs;
+        double coldMs;
+        double warmMs;
+        loadTexture(false, rawMs);
+        loadTexture(true, coldMs);
+        loadTexture(true, warmMs);
+
+        TextureImage raw;
+        TextureImage cooked;
+        setTextureCooking(false);
+        decodeTextureImage(filename, raw, usage);
+        setTextureCooking(true);
+        decodeTextureImage(filename, cooked, usage);
+        setTextureCooking(wasCooking);
+        if (!raw.pixels || !cooked.compressed.isValid()) {
+            std::cout << "BENCHMARK::TEXTURE_COMPRESSION:: " << filename << " could not be cooked." << std::endl;
+            freeTextureImage(raw);
+            freeTextureImage(cooked);
+            return;
+        }
+
+        std::vector<uint8_t> decoded;
+        decompressLevel(cooked.compressed, 0, decoded);
+        int channels = std::min(raw.components, cooked.compressed.format == BLOCK_BC5 ? 2 : cooked.components);
+        double squaredError = 0.0;
+        size_t pixelCount = static_cast<size_t>(raw.width) * raw.height;
+        for (size_t i = 0; i < pixelCount; i++) {
+            for (int c = 0; c < channels; c++) {
+                double difference = static_cast<double>(raw.pixels[i * raw.components + c]) - decoded[i * 4 + c];
+                squaredError += difference * difference;
+            }
+        }
+
+        size_t rawBytes = pixelCount * raw.components;
+        rawBytes += rawBytes / 3;
+        const char* formats[] = { "BC1", "BC3", "BC5" };
+        std::cout << "BENCHMARK::TEXTURE_COMPRESSION:: " << filename << " " << raw.width << "x" << raw.height << " " << formats[cooked.compressed.format]
+            << ", " << cooked.compressed.getLevelCount() << " levels, GPU bytes: " << rawBytes << " raw, " << cooked.compressed.data.size() << " cooked"
+            << " RMSE: " << std::sqrt(squaredError / (pixelCount * channels)) << std::endl;
+        std::cout << "BENCHMARK::TEXTURE_COMPRESSION:: raw load: " << rawMs << " ms cold (decode + cook): " << coldMs << " ms"
+            << " warm (cooked): " << warmMs << " ms" << std::endl;
+        freeTextureImage(raw);
+        freeTextureImage(cooked);
+    }
+
+    // Vertex and index buffer bytes of a model in the full layout against the packed layouts, and the time to draw it
+    // with a shader that reads every attribute. The bytes are what each draw of the model fetches at least once.
+    inline void runVertexFormatBenchmark(const std::string& path, bool isCharacter, int draws = 200)
+    {
+        const std::string vertexSource =
+            "#version 330 core\n"
+            "layout(location = 0) in vec3 aPos;\n"
+            "layout(location = 1) in vec3 aNormal;\n"
+            "layout(location = 2) in vec2 aTexCoords;\n"
+            "layout(location = 3) in vec4 aTangent;\n"
+            "layout(location = 5) in ivec4 aBoneIDs;\n"
+            "layout(location = 6) in vec4 aWeights;\n"
+            "out vec4 color;\n"
+            "void main() {\n"
+            "    gl_Position = vec4(aPos * 0.001, 1.0);\n"
+            "    color = vec4(aNormal + aTangent.xyz * aTangent.w, aTexCoords.x + aTexCoords.y) + aWeights * float(aBoneIDs.x + 1);\n"
+            "}\n";
+        const std::string fragmentSource =
+            "#version 330 core\n"
+            "in vec4 color;\n"
+            "out vec4 FragColor;\n"
+            "void main() { FragColor = color; }\n";
+        GLuint program = compileProgram(vertexSource, fragmentSource);
+
+        bool wasPacking = isVertexPackingEnabled();
+        const char* names[] = { "full", "packed" };
+        size_t vertexBytes[2] = { 0, 0 };
+        size_t indexBytes[2] = { 0, 0 };
+        double drawMs[2] = { 0.0, 0.0 };
+        int layoutCounts[3] = { 0, 0, 0 };
+        size_t vertexCount = 0;
+        for (int packed = 0; packed < 2; packed++) {
+            setVertexPacking(packed == 1);
+            Model model(path, isCharacter);
+            for (const Mesh& mesh : model.meshes) {
+                vertexBytes[packed] += mesh.getVertexBufferBytes();
+                indexBytes[packed] += mesh.getIndexBufferBytes();
+                if (packed) {
+                    layoutCounts[mesh.getVertexLayout()]++;
+                    vertexCount += mesh.getVertexCount();
+                }
+            }
+
+            glUseProgram(program);
+            glFinish();
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < draws; i++) {
+                for (const Mesh& mesh : model.meshes) {
+                    glBindVertexArray(mesh.VAO);
+                    if (!mesh.hasSkinStreams()) {
+                        clearSkinAttributes();  // As Mesh::Draw, so static meshes are not skinned by stale attributes
+                    }
+                    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.getIndexCount()), mesh.getIndexType(), 0);
+                }
+            }
+            glFinish();
+            drawMs[packed] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / draws;
+            glBindVertexArray(0);
+        }
+        setVertexPacking(wasPacking);
+        glDeleteProgram(program);
+
+        std::cout << "BENCHMARK::VERTEX_FORMAT:: " << path << " " << vertexCount << " vertices, meshes full/skinned/static: "
+            << layoutCounts[VERTEX_FULL] << "/" << layoutCounts[VERTEX_PACKED_SKINNED] << "/" << layoutCounts[VERTEX_PACKED_STATIC] << std::endl;
+        for (int packed = 0; packed < 2; packed++) {
+            std::cout << "BENCHMARK::VERTEX_FORMAT:: " << names[packed] << ": vertex bytes: " << vertexBytes[packed]
+                << " index bytes: " << indexBytes[packed] << " fetched per draw: " << vertexBytes[packed] + indexBytes[packed]
+                << " bytes, draw: " << drawMs[packed] << " ms" << std::endl;
+        }
+        size_t fullBytes = vertexBytes[0] + indexBytes[0];
+        size_t packedBytes = vertexBytes[1] + indexBytes[1];
+        std::cout << "BENCHMARK::VERTEX_FORMAT:: saved: " << fullBytes - packedBytes << " bytes ("
+            << (fullBytes > 0 ? 100.0 * (fullBytes - packedBytes) / fullBytes : 0.0) << "%)" << std::endl;
+    }
+}
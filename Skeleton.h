@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Local-space transform of one joint, before it is composed into a matrix
+struct JointPose
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    glm::mat4 toMatrix() const
+    {
+        glm::mat4 positionMat = glm::translate(glm::mat4(1.0f), position);
+        glm::mat4 rotationMat = glm::mat4_cast(rotation);
+        glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
+
+        return positionMat * rotationMat * scaleMat;
+    }
+};
+
+// Compiled, index-based skeleton.
+// Joints are stored in topological order (a parent always comes before its children),
+// so a full pose can be evaluated with a single forward loop over contiguous arrays.
+struct Skeleton
+{
+    static const int NO_PARENT = -1;
+    static const int NO_JOINT = -1;
+
+    std::vector<std::string> names;
+    std::vector<int> parents;          // parent joint index, NO_PARENT for the root
+    std::vector<int> boneIDs;          // slot in the bone palette written for this joint
+    std::vector<glm::mat4> offsets;    // inverse bind (offset) matrices
+
+    // Appends a joint. The parent must already have been added, which keeps the order topological.
+    int addJoint(const std::string& name, int parent, int boneID)
+    {
+        int index = static_cast<int>(names.size());
+        names.push_back(name);
+        parents.push_back(parent);
+        boneIDs.push_back(boneID);
+        offsets.push_back(glm::mat4(1.0f));
+        jointIndexByName[name] = index;
+        return index;
+    }
+
+    // Load-time lookup only, never call this from the per-frame path
+    int findJoint(const std::string& name) const
+    {
+        auto it = jointIndexByName.find(name);
+        return it != jointIndexByName.end() ? it->second : NO_JOINT;
+    }
+
+    int size() const
+    {
+        return static_cast<int>(names.size());
+    }
+
+    bool empty() const
+    {
+        return names.empty();
+    }
+
+    // Links from each joint down to the end of its deepest chain: 0 for leaves such as finger tips
+    std::vector<int> computeJointHeights() const
+    {
+        std::vector<int> heights(names.size(), 0);
+        for (int i = size() - 1; i >= 0; i--) {
+            if (parents[i] != NO_PARENT) {
+                heights[parents[i]] = std::max(heights[parents[i]], heights[i] + 1);
+            }
+        }
+        return heights;
+    }
+
+private:
+    std::unordered_map<std::string, int> jointIndexByName;
+};
@@ -0,0 +1,167 @@
+#include "SkinningFeedback.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "BonePalette.h"
+
+const GLsizei SKINNED_VERTEX_STRIDE = 6 * sizeof(float);  // Interleaved SkinnedPosition, SkinnedNormal
+
+PreSkinnedBuffers::~PreSkinnedBuffers()
+{
+    release();
+}
+
+void PreSkinnedBuffers::allocate(const Model& model)
+{
+    if (this->model == &model && vertexArrays.size() == model.meshes.size()) return;
+    release();
+    this->model = &model;
+
+    size_t meshCount = model.meshes.size();
+    skinnedVertices.resize(meshCount);
+    vertexArrays.resize(meshCount);
+    glGenBuffers(static_cast<GLsizei>(meshCount), skinnedVertices.data());
+    glGenVertexArrays(static_cast<GLsizei>(meshCount), vertexArrays.data());
+
+    for (size_t i = 0; i < meshCount; i++) {
+        const Mesh& mesh = model.meshes[i];
+        size_t bytes = mesh.getVertexCount() * SKINNED_VERTEX_STRIDE;
+        sizeInBytes += bytes;
+
+        glBindVertexArray(vertexArrays[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, skinnedVertices[i]);
+        // Written and read by the GPU only
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, SKINNED_VERTEX_STRIDE, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, SKINNED_VERTEX_STRIDE, (void*)(3 * sizeof(float)));
+
+        // Texture coordinates and indices stay in the mesh's buffers
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.getVertexBuffer());
+        setVertexAttributes(mesh.getVertexLayout(), vertexAttributeBit(2));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.getElementBuffer());
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    OpenGLErrors::checkOpenGLError("PreSkinnedBuffers::allocate");
+}
+
+void PreSkinnedBuffers::release()
+{
+    if (!vertexArrays.empty()) {
+        glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+        glDeleteBuffers(static_cast<GLsizei>(skinnedVertices.size()), skinnedVertices.data());
+    }
+    vertexArrays.clear();
+    skinnedVertices.clear();
+    model = nullptr;
+    sizeInBytes = 0;
+    skinned = false;
+}
+
+void PreSkinnedBuffers::Draw(const Model& model, Shader& shader) const
+{
+    if (this->model != &model) return;
+    for (size_t i = 0; i < vertexArrays.size(); i++) {
+        model.meshes[i].Draw(shader, vertexArrays[i]);
+    }
+}
+
+SkinningFeedback::SkinningFeedback(const char* linearPath, const char* dualQuaternionPath)
+{
+    linearProgram = buildProgram(linearPath);
+    dualQuaternionProgram = buildProgram(dualQuaternionPath);
+}
+
+SkinningFeedback::~SkinningFeedback()
+{
+    if (linearProgram) glDeleteProgram(linearProgram);
+    if (dualQuaternionProgram) glDeleteProgram(dualQuaternionProgram);
+}
+
+void SkinningFeedback::begin()
+{
+    glEnable(GL_RASTERIZER_DISCARD);
+    boundProgram = 0;
+}
+
+void SkinningFeedback::skin(const Model& model, const glm::mat4* palette, int count, PreSkinnedBuffers& buffers)
+{
+    GLuint program = model.getSkinningMode() == DUAL_QUATERNION_SKINNING ? dualQuaternionProgram : linearProgram;
+    if (!program) return;
+
+    buffers.allocate(model);
+    if (program != boundProgram) {
+        glUseProgram(program);
+        boundProgram = program;
+    }
+    sharedBonePalette().upload(program, palette, count);
+
+    // One point per vertex, captured in vertex order so the mesh's indices still apply
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers.skinnedVertices[i]);
+        glBindVertexArray(mesh.VAO);
+        if (!mesh.hasSkinStreams()) {
+            clearSkinAttributes();
+        }
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(mesh.getVertexCount()));
+        glEndTransformFeedback();
+    }
+    buffers.skinned = true;
+}
+
+void SkinningFeedback::end()
+{
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    boundProgram = 0;
+    OpenGLErrors::checkOpenGLError("SkinningFeedback::end");
+}
+
+GLuint SkinningFeedback::buildProgram(const char* vertexPath)
+{
+    std::ifstream file(vertexPath);
+    if (!file) {
+        std::cout << "ERROR::SKINNING_FEEDBACK:: Could not read " << vertexPath << std::endl;
+        return 0;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string source = stream.str();
+    const char* code = source.c_str();
+
+    GLint success;
+    GLchar infoLog[1024];
+    GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+        std::cout << "ERROR::SKINNING_FEEDBACK:: " << vertexPath << " failed to compile\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    // Vertex-only program, the varyings have to be chosen before linking
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    const char* varyings[] = { "SkinnedPosition", "SkinnedNormal" };
+    glTransformFeedbackVaryings(program, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        std::cout << "ERROR::SKINNING_FEEDBACK:: " << vertexPath << " failed to link\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "Model.h"
+
+// Skinned vertices of one instance, written once per frame by SkinningFeedback and drawn by every later pass
+// as a static mesh. One interleaved position + normal buffer per mesh of the model, plus a vertex array that
+// reads it together with the mesh's own texture coordinates and indices.
+class PreSkinnedBuffers
+{
+public:
+    PreSkinnedBuffers() = default;
+    PreSkinnedBuffers(const PreSkinnedBuffers&) = delete;
+    PreSkinnedBuffers& operator=(const PreSkinnedBuffers&) = delete;
+    ~PreSkinnedBuffers();
+
+    // Creates the buffers for the model's meshes, or recreates them when the model changed
+    void allocate(const Model& model);
+    void release();
+
+    // Draws the model from the skinned buffers, with a shader that does no skinning such as PreSkinnedVertex.vs
+    void Draw(const Model& model, Shader& shader) const;
+
+    // True once SkinningFeedback has written this allocation in the current pre-skin pass
+    bool isSkinned() const {
+        return skinned;
+    }
+
+    // Marks the vertices as last frame's, called at the start of each pre-skin pass so an instance that is not
+    // skinned again is drawn by the skinning shader instead of in a stale pose
+    void invalidate() {
+        skinned = false;
+    }
+
+    GLuint getSkinnedVertexBuffer(size_t mesh) const {
+        return skinnedVertices[mesh];
+    }
+
+    size_t getSizeInBytes() const {
+        return sizeInBytes;
+    }
+
+private:
+    friend class SkinningFeedback;
+
+    const Model* model = nullptr;
+    std::vector<GLuint> skinnedVertices;  // Transform feedback target per mesh
+    std::vector<GLuint> vertexArrays;     // Static draw setup per mesh
+    size_t sizeInBytes = 0;
+    bool skinned = false;
+};
+
+// Pre-skinning stage. Runs the skinning shaders once per instance with rasterization disabled and captures
+// the skinned vertices into the instance's PreSkinnedBuffers, so shadow, depth and color passes stop re-skinning.
+// Models set to DUAL_QUATERNION_SKINNING are skinned with the dual quaternion variant.
+class SkinningFeedback
+{
+public:
+    SkinningFeedback(const char* linearPath = "SkinningFeedback.vs", const char* dualQuaternionPath = "DualQuatSkinningFeedback.vs");
+    SkinningFeedback(const SkinningFeedback&) = delete;
+    SkinningFeedback& operator=(const SkinningFeedback&) = delete;
+    ~SkinningFeedback();
+
+    bool isValid() const {
+        return linearProgram != 0 && dualQuaternionProgram != 0;
+    }
+
+    // Skinning calls go between begin and end. end leaves no program bound.
+    void begin();
+    void skin(const Model& model, const glm::mat4* palette, int count, PreSkinnedBuffers& buffers);
+    void end();
+
+private:
+    GLuint linearProgram = 0;
+    GLuint dualQuaternionProgram = 0;
+    GLuint boundProgram = 0;
+
+    static GLuint buildProgram(const char* vertexPath);
+};
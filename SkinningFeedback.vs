@@ -0,0 +1,37 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 5) in ivec4 aBoneIDs;
+layout(location = 6) in vec4 aWeights;
+
+#define MAX_BONES 100 // Same as MAX_BONES in BonePalette.h
+
+// Filled by BonePalette with one buffer update per draw
+layout(std140) uniform BonePalette
+{
+    mat4 bones[MAX_BONES];
+};
+
+// Captured by transform feedback into the instance's pre-skinned buffer, in model space
+out vec3 SkinnedPosition;
+out vec3 SkinnedNormal;
+
+void main()
+{
+    mat4 boneTransform = mat4(1.0);
+
+    // Same blend as vertex.vs
+    if (aWeights[0] + aWeights[1] + aWeights[2] + aWeights[3] > 0.0) {
+        boneTransform = bones[aBoneIDs[0]] * aWeights[0];
+        boneTransform += bones[aBoneIDs[1]] * aWeights[1];
+        boneTransform += bones[aBoneIDs[2]] * aWeights[2];
+        boneTransform += bones[aBoneIDs[3]] * aWeights[3];
+    }
+
+    SkinnedPosition = vec3(boneTransform * vec4(aPos, 1.0));
+    SkinnedNormal = mat3(transpose(inverse(boneTransform))) * aNormal;
+
+    // Nothing is rasterized, the position is only written to keep the stage complete
+    gl_Position = vec4(SkinnedPosition, 1.0);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+#include "Mesh.h"
+#include "PoseKernel.h"
+#include "JobSystem.h"
+
+const int SKINNING_JOB_VERTICES = 4096;  // Vertices per job when skinning in parallel, a multiple of POSE_BATCH_PADDING
+
+// Skinning inputs of one mesh, built once from Mesh::vertices.
+// Stored structure-of-arrays and padded like PoseSamplingBatch, so every SIMD lane is one vertex.
+struct SkinningInput
+{
+    enum Stream
+    {
+        PX, PY, PZ, NX, NY, NZ,
+        W0, W1, W2, W3,
+        UNSKINNED,  // 1 for vertices without weights, which the shader leaves untransformed
+        STREAM_COUNT
+    };
+
+    int count = 0;
+    int capacity = 0;
+    std::vector<float> streams = {};
+    std::vector<int> boneOffsets = {};  // Four streams of boneID * 16, the float offset of each influence's matrix in the palette
+
+    void build(const std::vector<Vertex>& vertices)
+    {
+        count = static_cast<int>(vertices.size());
+        capacity = (count + POSE_BATCH_PADDING - 1) / POSE_BATCH_PADDING * POSE_BATCH_PADDING;
+        streams.assign(static_cast<size_t>(STREAM_COUNT) * capacity, 0.0f);
+        boneOffsets.assign(static_cast<size_t>(4) * capacity, 0);
+
+        for (int i = 0; i < count; i++) {
+            const Vertex& vertex = vertices[i];
+            stream(PX)[i] = vertex.Position.x; stream(PY)[i] = vertex.Position.y; stream(PZ)[i] = vertex.Position.z;
+            stream(NX)[i] = vertex.Normal.x; stream(NY)[i] = vertex.Normal.y; stream(NZ)[i] = vertex.Normal.z;
+            float weightSum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                stream(static_cast<Stream>(W0 + k))[i] = vertex.Weights[k];
+                boneOffset(k)[i] = vertex.BoneIDs[k] * 16;
+                weightSum += vertex.Weights[k];
+            }
+            stream(UNSKINNED)[i] = weightSum > 0.0f ? 0.0f : 1.0f;
+        }
+        // Padding lanes are unskinned too, so their matrix stays invertible
+        for (int i = count; i < capacity; i++) {
+            stream(UNSKINNED)[i] = 1.0f;
+        }
+    }
+
+    float* stream(Stream s) { return streams.data() + static_cast<size_t>(s) * capacity; }
+    const float* stream(Stream s) const { return streams.data() + static_cast<size_t>(s) * capacity; }
+    int* boneOffset(int influence) { return boneOffsets.data() + static_cast<size_t>(influence) * capacity; }
+    const int* boneOffset(int influence) const { return boneOffsets.data() + static_cast<size_t>(influence) * capacity; }
+};
+
+// Skinned positions and normals, structure-of-arrays with the same padding as the input
+struct SkinnedVertices
+{
+    enum Stream
+    {
+        PX, PY, PZ, NX, NY, NZ,
+        STREAM_COUNT
+    };
+
+    int count = 0;
+    int capacity = 0;
+    std::vector<float> streams = {};
+
+    void resize(const SkinningInput& input)
+    {
+        count = input.count;
+        if (capacity != input.capacity) {
+            capacity = input.capacity;
+            streams.assign(static_cast<size_t>(STREAM_COUNT) * capacity, 0.0f);
+        }
+    }
+
+    float* stream(Stream s) { return streams.data() + static_cast<size_t>(s) * capacity; }
+    const float* stream(Stream s) const { return streams.data() + static_cast<size_t>(s) * capacity; }
+
+    glm::vec3 getPosition(int i) const {
+        return glm::vec3(stream(PX)[i], stream(PY)[i], stream(PZ)[i]);
+    }
+
+    glm::vec3 getNormal(int i) const {
+        return glm::vec3(stream(NX)[i], stream(NY)[i], stream(NZ)[i]);
+    }
+};
+
+// Linear blend skinning on the CPU, the same math as vertex.vs: positions go through the blended bone matrix,
+// normals through its inverse transpose. Usable without a GL context, as a fallback and as the reference the
+// shaders are tested against. Every bone ID of the mesh must index into the palette.
+namespace SkinningKernel
+{
+    template <typename V>
+    inline void skinLanes(const SkinningInput& input, const float* palette, SkinnedVertices& output, int begin, int end)
+    {
+        typedef SkinningInput I;
+        typedef SkinnedVertices O;
+
+        for (int i = begin; i < end; i += V::WIDTH) {
+            // Blended matrix, upper 3x4 in glm's column-major order. Unweighted vertices start from identity
+            V unskinned = V::load(input.stream(I::UNSKINNED) + i);
+            V zero = V::set(0.0f);
+            V m[12] = { unskinned, zero, zero, zero, unskinned, zero, zero, zero, unskinned, zero, zero, zero };
+            for (int k = 0; k < 4; k++) {
+                V weight = V::load(input.stream(static_cast<I::Stream>(I::W0 + k)) + i);
+                const int* offsets = input.boneOffset(k) + i;
+                for (int column = 0; column < 4; column++) {
+                    for (int row = 0; row < 3; row++) {
+                        V& element = m[column * 3 + row];
+                        element = element + weight * V::gather(palette + column * 4 + row, offsets);
+                    }
+                }
+            }
+
+            V px = V::load(input.stream(I::PX) + i);
+            V py = V::load(input.stream(I::PY) + i);
+            V pz = V::load(input.stream(I::PZ) + i);
+            (m[0] * px + m[3] * py + m[6] * pz + m[9]).store(output.stream(O::PX) + i);
+            (m[1] * px + m[4] * py + m[7] * pz + m[10]).store(output.stream(O::PY) + i);
+            (m[2] * px + m[5] * py + m[8] * pz + m[11]).store(output.stream(O::PZ) + i);
+
+            // Inverse transpose of the 3x3 part: its cofactor columns are cross products of the axes, divided by the determinant
+            V c0x = m[4] * m[8] - m[5] * m[7], c0y = m[5] * m[6] - m[3] * m[8], c0z = m[3] * m[7] - m[4] * m[6];
+            V c1x = m[7] * m[2] - m[8] * m[1], c1y = m[8] * m[0] - m[6] * m[2], c1z = m[6] * m[1] - m[7] * m[0];
+            V c2x = m[1] * m[5] - m[2] * m[4], c2y = m[2] * m[3] - m[0] * m[5], c2z = m[0] * m[4] - m[1] * m[3];
+            V determinant = m[0] * c0x + m[1] * c0y + m[2] * c0z;
+
+            V nx = V::load(input.stream(I::NX) + i);
+            V ny = V::load(input.stream(I::NY) + i);
+            V nz = V::load(input.stream(I::NZ) + i);
+            ((c0x * nx + c1x * ny + c2x * nz) / determinant).store(output.stream(O::NX) + i);
+            ((c0y * nx + c1y * ny + c2y * nz) / determinant).store(output.stream(O::NY) + i);
+            ((c0z * nx + c1z * ny + c2z * nz) / determinant).store(output.stream(O::NZ) + i);
+        }
+    }
+
+    inline void skinVerticesScalar(const SkinningInput& input, const glm::mat4* palette, SkinnedVertices& output)
+    {
+        output.resize(input);
+        skinLanes<PoseKernel::ScalarLanes>(input, &palette[0][0][0], output, 0, input.count);
+    }
+
+    // Skins vertices [begin, end) with the widest kernel this build supports. begin must be a multiple of
+    // POSE_BATCH_PADDING and output already sized for the input.
+    inline void skinVertexRange(const SkinningInput& input, const glm::mat4* palette, SkinnedVertices& output, int begin, int end)
+    {
+        end = std::min((end + POSE_BATCH_PADDING - 1) / POSE_BATCH_PADDING * POSE_BATCH_PADDING, input.capacity);
+#if defined(POSE_KERNEL_AVX2)
+        skinLanes<PoseKernel::Avx2Lanes>(input, &palette[0][0][0], output, begin, end);
+#elif defined(POSE_KERNEL_SSE)
+        skinLanes<PoseKernel::SseLanes>(input, &palette[0][0][0], output, begin, end);
+#else
+        skinLanes<PoseKernel::ScalarLanes>(input, &palette[0][0][0], output, begin, std::min(end, input.count));
+#endif
+    }
+
+    inline void skinVertices(const SkinningInput& input, const glm::mat4* palette, SkinnedVertices& output)
+    {
+        output.resize(input);
+        skinVertexRange(input, palette, output, 0, input.count);
+    }
+
+    // Splits the mesh into jobs of SKINNING_JOB_VERTICES and returns once every range is skinned
+    inline void skinVerticesParallel(JobSystem& jobSystem, const SkinningInput& input, const glm::mat4* palette, SkinnedVertices& output)
+    {
+        output.resize(input);
+        auto skinJob = [&](int job) {
+            int begin = job * SKINNING_JOB_VERTICES;
+            skinVertexRange(input, palette, output, begin, std::min(begin + SKINNING_JOB_VERTICES, input.count));
+        };
+        JobGroup group;
+        int jobCount = (input.count + SKINNING_JOB_VERTICES - 1) / SKINNING_JOB_VERTICES;
+        jobSystem.parallelFor(group, jobCount, 1, skinJob);
+        jobSystem.wait(group);
+    }
+}
@@ -11,28 +11,31 @@ public:
 
     TerrainModel(const string& path, bool gamma = false) : Model(path, false, gamma) {
         generateHeightMap();
+        // Heights are sampled from the map from now on, positions and indices stay for collision
+        releaseMeshGeometry(KEEP_COLLISION_GEOMETRY);
     }
 
 private:
     void generateHeightMap() {
         // Assuming terrain is a single mesh in the model
-        if (meshes.empty()) return;
+        if (meshes.empty() || meshes[0].getPositionCount() == 0) return;
 
         const auto& mesh = meshes[0];
         float minHeight = std::numeric_limits<float>::max();
         float maxHeight = std::numeric_limits<float>::min();
 
         // Determine the bounds and grid spacing based on vertices
-        minX = maxX = mesh.vertices[0].Position.x;
-        minZ = maxZ = mesh.vertices[0].Position.z;
+        minX = maxX = mesh.getPosition(0).x;
+        minZ = maxZ = mesh.getPosition(0).z;
 
-        for (const auto& vertex : mesh.vertices) {
-            minX = std::min(minX, vertex.Position.x);
-            maxX = std::max(maxX, vertex.Position.x);
-            minZ = std::min(minZ, vertex.Position.z);
-            maxZ = std::max(maxZ, vertex.Position.z);
-            minHeight = std::min(minHeight, vertex.Position.y);
-            maxHeight = std::max(maxHeight, vertex.Position.y);
+        for (size_t i = 0; i < mesh.getPositionCount(); i++) {
+            const glm::vec3& position = mesh.getPosition(i);
+            minX = std::min(minX, position.x);
+            maxX = std::max(maxX, position.x);
+            minZ = std::min(minZ, position.z);
+            maxZ = std::max(maxZ, position.z);
+            minHeight = std::min(minHeight, position.y);
+            maxHeight = std::max(maxHeight, position.y);
         }
 
         // Assuming a fixed grid size for simplicity
@@ -44,10 +47,11 @@ private:
         heightMap.resize(gridWidth, std::vector<float>(gridDepth, minHeight));
 
         // Fill the heightMap with the maximum heights at each grid position
-        for (const auto& vertex : mesh.vertices) {
-            int gridX = static_cast<int>((vertex.Position.x - minX) / gridSpacingX);
-            int gridZ = static_cast<int>((vertex.Position.z - minZ) / gridSpacingZ);
-            heightMap[gridX][gridZ] = std::max(heightMap[gridX][gridZ], vertex.Position.y);
+        for (size_t i = 0; i < mesh.getPositionCount(); i++) {
+            const glm::vec3& position = mesh.getPosition(i);
+            int gridX = static_cast<int>((position.x - minX) / gridSpacingX);
+            int gridZ = static_cast<int>((position.z - minZ) / gridSpacingZ);
+            heightMap[gridX][gridZ] = std::max(heightMap[gridX][gridZ], position.y);
         }
     }
 
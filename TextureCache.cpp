@@ -0,0 +1,185 @@
+#include "TextureCache.h"
+
+#include <cstring>
+#include <iostream>
+#include <glad/glad.h>
+#include "TextureStreamer.h"
+
+namespace
+{
+    // Level 0 plus the rest of the mip chain, a third more. Cooked images know their exact size.
+    size_t estimateTextureBytes(const TextureImage& image)
+    {
+        if (image.compressed.isValid()) return image.compressed.data.size();
+        size_t levelZero = static_cast<size_t>(image.width) * image.height * image.components;
+        return levelZero + levelZero / 3;
+    }
+
+    // Whether two decoded images hold the same texels, a matching content hash alone could be a collision
+    bool sameContent(const TextureImage& a, const TextureImage& b)
+    {
+        if (a.width != b.width || a.height != b.height || a.components != b.components) return false;
+        if (a.compressed.isValid() || b.compressed.isValid()) {
+            return a.compressed.isValid() && b.compressed.isValid()
+                && a.compressed.format == b.compressed.format && a.compressed.data == b.compressed.data;
+        }
+        size_t size = static_cast<size_t>(a.width) * a.height * a.components;
+        return a.pixels && b.pixels && memcmp(a.pixels, b.pixels, size) == 0;
+    }
+}
+
+unsigned int TextureCache::acquire(const std::string& resolvedPath, TextureImage* decoded, TextureUsage usage)
+{
+    // The lock only covers the maps: decoding and uploading run without it, so loader threads asking isCached
+    // do not wait on them
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        unsigned int id = referencePath(resolvedPath);
+        if (id) {
+            if (decoded) freeTextureImage(*decoded);
+            return id;
+        }
+    }
+
+    TextureImage local;
+    TextureImage& image = decoded && decoded->hasData() ? *decoded : local;
+    if (!image.hasData()) {
+        decodeTextureImage(resolvedPath, image, usage);
+    }
+
+    // The same pixels under another name
+    unsigned int sharedId = 0;
+    if (image.hasData()) {
+        std::string candidatePath;
+        TextureUsage candidateUsage = TEXTURE_COLOR;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto byContent = idsByContent.find(image.contentHash);
+            if (byContent != idsByContent.end()) {
+                const Entry& candidate = entries[byContent->second];
+                sharedId = byContent->second;
+                candidatePath = candidate.paths[0];
+                candidateUsage = candidate.usage;
+            }
+        }
+        if (sharedId) {
+            // Only the hash is kept once a texture is uploaded, decode the first image again to compare
+            TextureImage existing;
+            if (!decodeTextureImage(candidatePath, existing, candidateUsage) || !sameContent(image, existing)) {
+                sharedId = 0;
+            }
+            freeTextureImage(existing);
+        }
+    }
+
+    Entry entry;
+    entry.references = 1;
+    entry.paths.push_back(resolvedPath);
+    entry.usage = usage;
+    if (image.hasData()) {
+        entry.bytes = estimateTextureBytes(image);
+        entry.hasContentHash = true;
+        entry.contentHash = image.contentHash;
+    }
+    else {
+        entry.bytes = 3;  // The 1x1 default texture
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // The path may have been acquired, or the matching texture released, while the lock was dropped
+        unsigned int id = referencePath(resolvedPath);
+        auto shared = sharedId ? entries.find(sharedId) : entries.end();
+        if (!id && shared != entries.end() && shared->second.contentHash == entry.contentHash) {
+            shared->second.references++;
+            shared->second.paths.push_back(resolvedPath);
+            idsByPath[resolvedPath] = sharedId;
+            id = sharedId;
+        }
+        if (id) {
+            freeTextureImage(image);
+            return id;
+        }
+    }
+
+    unsigned int id = uploadTextureImage(image);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned int racing = referencePath(resolvedPath);
+    if (racing) {
+        // Loaded by another acquire during the upload, keep the texture already handed out
+        sharedTextureStreamer().stopStreaming(id);
+        glDeleteTextures(1, &id);
+        return racing;
+    }
+    if (entry.hasContentHash) {
+        idsByContent.insert({ entry.contentHash, id });  // On a collision the first texture keeps the hash
+    }
+    idsByPath[resolvedPath] = id;
+    entries[id] = entry;
+    return id;
+}
+
+void TextureCache::release(unsigned int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(id);
+    if (it == entries.end()) return;
+    if (--it->second.references > 0) return;
+
+    for (const std::string& path : it->second.paths) {
+        idsByPath.erase(path);
+    }
+    auto byContent = it->second.hasContentHash ? idsByContent.find(it->second.contentHash) : idsByContent.end();
+    if (byContent != idsByContent.end() && byContent->second == id) {
+        idsByContent.erase(byContent);
+    }
+    entries.erase(it);
+    sharedTextureStreamer().stopStreaming(id);
+    glDeleteTextures(1, &id);
+}
+
+unsigned int TextureCache::referencePath(const std::string& resolvedPath)
+{
+    auto byPath = idsByPath.find(resolvedPath);
+    if (byPath == idsByPath.end()) return 0;
+    entries[byPath->second].references++;
+    return byPath->second;
+}
+
+bool TextureCache::isCached(const std::string& resolvedPath) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return idsByPath.find(resolvedPath) != idsByPath.end();
+}
+
+size_t TextureCache::getTextureBytes(unsigned int id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    return it != entries.end() ? it->second.bytes : 0;
+}
+
+TextureCacheStats TextureCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    TextureCacheStats stats;
+    for (const auto& pair : entries) {
+        stats.textureCount++;
+        stats.referenceCount += pair.second.references;
+        stats.gpuBytes += pair.second.bytes;
+        stats.unsharedGpuBytes += pair.second.bytes * pair.second.references;
+    }
+    return stats;
+}
+
+void TextureCache::printReport() const
+{
+    TextureCacheStats stats = getStats();
+    std::cout << "TEXTURE_CACHE:: " << stats.textureCount << " textures, " << stats.referenceCount << " references"
+        << " GPU bytes: " << stats.gpuBytes << " shared, " << stats.unsharedGpuBytes << " without sharing"
+        << " saved: " << stats.unsharedGpuBytes - stats.gpuBytes << std::endl;
+}
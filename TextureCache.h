@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TextureUtility.h"
+
+struct TextureCacheStats
+{
+    int textureCount = 0;         // GL textures alive
+    int referenceCount = 0;       // Outstanding acquires
+    size_t gpuBytes = 0;          // Estimated, mip chains included
+    size_t unsharedGpuBytes = 0;  // What the same references would cost with a texture each
+};
+
+// Process-wide texture cache shared by every model.
+// Textures are found by resolved file path and, after decoding, by a hash of their pixels, so the terrain, the gun and
+// every character share one GL texture per image. Each acquire takes a reference; the texture is deleted when the last
+// one is released. Acquire and release run on the GL thread, isCached may be asked from loader threads; the lock is
+// never held while decoding or uploading.
+class TextureCache
+{
+public:
+    TextureCache() = default;
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Texture for the file at resolvedPath, decoded and uploaded on first use. An image the caller already decoded
+    // is used when the path is new and freed otherwise. The usage picks the block format when the image gets cooked.
+    unsigned int acquire(const std::string& resolvedPath, TextureImage* decoded = nullptr, TextureUsage usage = TEXTURE_COLOR);
+    void release(unsigned int id);
+
+    // Whether the file is loaded already, so a loader thread can skip decoding it
+    bool isCached(const std::string& resolvedPath) const;
+
+    // Estimated GPU bytes of one texture, 0 for ids the cache does not hold
+    size_t getTextureBytes(unsigned int id) const;
+
+    TextureCacheStats getStats() const;
+    void printReport() const;
+
+private:
+    struct Entry
+    {
+        int references = 0;
+        size_t bytes = 0;
+        bool hasContentHash = false;
+        uint64_t contentHash = 0;
+        std::vector<std::string> paths;  // Every path that resolved to this texture
+        TextureUsage usage = TEXTURE_COLOR;  // To decode paths[0] again when another image has the same hash
+    };
+
+    // Takes a reference on the texture already loaded for the path, 0 if there is none. Called with the mutex held.
+    unsigned int referencePath(const std::string& resolvedPath);
+
+    mutable std::mutex mutex;  // Guards the maps against isCached from loader threads
+    std::unordered_map<std::string, unsigned int> idsByPath;
+    std::unordered_map<uint64_t, unsigned int> idsByContent;
+    std::unordered_map<unsigned int, Entry> entries;  // By GL texture id
+};
+
+// Cache shared by every model
+inline TextureCache& sharedTextureCache()
+{
+    static TextureCache cache;
+    return cache;
+}
@@ -0,0 +1,528 @@
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glad/glad.h>
+
+namespace
+{
+    const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    const uint32_t KTX_ENDIANNESS = 0x04030201;
+    const char KTX_STAMP_KEY[] = "SourceStamp";  // Value: uint64 source size, int64 source modification time
+
+    struct KtxHeader
+    {
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    std::atomic<unsigned int> tempFileCounter{ 0 };
+
+    size_t getLevelSize(BlockFormat format, int width, int height)
+    {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+
+    // The 16 RGBA pixels of a 4x4 block, edge pixels repeated past the border of the image
+    void fetchBlock(const uint8_t* rgba, int width, int height, int blockX, int blockY, uint8_t block[64])
+    {
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int sourceX = std::min(blockX * 4 + x, width - 1);
+                int sourceY = std::min(blockY * 4 + y, height - 1);
+                memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+            }
+        }
+    }
+
+    uint16_t packRgb565(const uint8_t* color)
+    {
+        int r = (color[0] * 31 + 127) / 255;
+        int g = (color[1] * 63 + 127) / 255;
+        int b = (color[2] * 31 + 127) / 255;
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRgb565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // BC1 color palette, always in four-color mode
+    void buildColorPalette(uint16_t color0, uint16_t color1, int palette[4][3])
+    {
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+    }
+
+    // Endpoints are the two pixels furthest apart along the principal axis of the block's colors
+    void encodeColorBlock(const uint8_t block[64], uint8_t out[8])
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) mean[c] += block[i * 4 + c] / 16.0f;
+        }
+        float covariance[6] = { 0.0f };  // rr rg rb gg gb bb
+        for (int i = 0; i < 16; i++) {
+            float r = block[i * 4] - mean[0];
+            float g = block[i * 4 + 1] - mean[1];
+            float b = block[i * 4 + 2] - mean[2];
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+            float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+            if (length < 1e-6f) break;  // Flat block, any axis will do
+            for (int c = 0; c < 3; c++) axis[c] = next[c] / length;
+        }
+
+        int minPixel = 0;
+        int maxPixel = 0;
+        float minProjection = 0.0f;
+        float maxProjection = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float projection = block[i * 4] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+            if (i == 0 || projection < minProjection) {
+                minProjection = projection;
+                minPixel = i;
+            }
+            if (i == 0 || projection > maxProjection) {
+                maxProjection = projection;
+                maxPixel = i;
+            }
+        }
+
+        uint16_t color0 = packRgb565(block + maxPixel * 4);
+        uint16_t color1 = packRgb565(block + minPixel * 4);
+        if (color0 < color1) std::swap(color0, color1);  // color0 > color1 selects four-color mode
+
+        uint32_t indices = 0;
+        if (color0 != color1) {
+            int palette[4][3];
+            buildColorPalette(color0, color1, palette);
+            for (int i = 0; i < 16; i++) {
+                int best = 0;
+                int bestDistance = 0;
+                for (int p = 0; p < 4; p++) {
+                    int distance = 0;
+                    for (int c = 0; c < 3; c++) {
+                        int difference = block[i * 4 + c] - palette[p][c];
+                        distance += difference * difference;
+                    }
+                    if (p == 0 || distance < bestDistance) {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (i * 2);
+            }
+        }
+
+        memcpy(out, &color0, 2);
+        memcpy(out + 2, &color1, 2);
+        memcpy(out + 4, &indices, 4);
+    }
+
+    void decodeColorBlock(const uint8_t in[8], uint8_t block[64])
+    {
+        uint16_t color0;
+        uint16_t color1;
+        uint32_t indices;
+        memcpy(&color0, in, 2);
+        memcpy(&color1, in + 2, 2);
+        memcpy(&indices, in + 4, 4);
+        int palette[4][3];
+        buildColorPalette(color0, color1, palette);
+        for (int i = 0; i < 16; i++) {
+            int index = (indices >> (i * 2)) & 3;
+            for (int c = 0; c < 3; c++) block[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+        }
+    }
+
+    // BC4 palette: the two endpoints and six values between them
+    void buildChannelPalette(int value0, int value1, int palette[8])
+    {
+        palette[0] = value0;
+        palette[1] = value1;
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+        }
+    }
+
+    // One channel of the block as a BC4 block, the alpha half of BC3 and either half of BC5
+    void encodeChannelBlock(const uint8_t block[64], int channel, uint8_t out[8])
+    {
+        int maxValue = block[channel];
+        int minValue = block[channel];
+        for (int i = 1; i < 16; i++) {
+            maxValue = std::max(maxValue, static_cast<int>(block[i * 4 + channel]));
+            minValue = std::min(minValue, static_cast<int>(block[i * 4 + channel]));
+        }
+
+        uint64_t indices = 0;
+        if (maxValue != minValue) {
+            int palette[8];
+            buildChannelPalette(maxValue, minValue, palette);
+            for (int i = 0; i < 16; i++) {
+                int value = block[i * 4 + channel];
+                int best = 0;
+                for (int p = 1; p < 8; p++) {
+                    if (std::abs(value - palette[p]) < std::abs(value - palette[best])) best = p;
+                }
+                indices |= static_cast<uint64_t>(best) << (i * 3);
+            }
+        }
+
+        out[0] = static_cast<uint8_t>(maxValue);
+        out[1] = static_cast<uint8_t>(minValue);
+        for (int i = 0; i < 6; i++) {
+            out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    void decodeChannelBlock(const uint8_t in[8], int channel, uint8_t block[64])
+    {
+        int palette[8];
+        buildChannelPalette(in[0], in[1], palette);
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++) {
+            indices |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+        }
+        for (int i = 0; i < 16; i++) {
+            block[i * 4 + channel] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+        }
+    }
+
+    void encodeLevel(const std::vector<uint8_t>& rgba, int width, int height, BlockFormat format, uint8_t* out)
+    {
+        size_t blockSize = getBlockSize(format);
+        uint8_t block[64];
+        for (int blockY = 0; blockY < (height + 3) / 4; blockY++) {
+            for (int blockX = 0; blockX < (width + 3) / 4; blockX++) {
+                fetchBlock(rgba.data(), width, height, blockX, blockY, block);
+                switch (format)
+                {
+                case BLOCK_BC1:
+                    encodeColorBlock(block, out);
+                    break;
+                case BLOCK_BC3:
+                    encodeChannelBlock(block, 3, out);
+                    encodeColorBlock(block, out + 8);
+                    break;
+                case BLOCK_BC5:
+                    encodeChannelBlock(block, 0, out);
+                    encodeChannelBlock(block, 1, out + 8);
+                    break;
+                }
+                out += blockSize;
+            }
+        }
+    }
+
+    // Next mip level by averaging 2x2 pixels, odd edges repeat their last pixel
+    void downsample(const std::vector<uint8_t>& rgba, int width, int height, std::vector<uint8_t>& next, int& nextWidth, int& nextHeight)
+    {
+        nextWidth = std::max(width / 2, 1);
+        nextHeight = std::max(height / 2, 1);
+        next.resize(static_cast<size_t>(nextWidth) * nextHeight * 4);
+        for (int y = 0; y < nextHeight; y++) {
+            int y0 = std::min(y * 2, height - 1);
+            int y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < nextWidth; x++) {
+                int x0 = std::min(x * 2, width - 1);
+                int x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; c++) {
+                    int sum = rgba[(static_cast<size_t>(y0) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                        + rgba[(static_cast<size_t>(y1) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                    next[(static_cast<size_t>(y) * nextWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+unsigned int CompressedTexture::getInternalFormat() const
+{
+    switch (format)
+    {
+    case BLOCK_BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    default:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+}
+
+unsigned int CompressedTexture::getBaseFormat() const
+{
+    switch (format)
+    {
+    case BLOCK_BC3:
+        return GL_RGBA;
+    case BLOCK_BC5:
+        return GL_RG;
+    default:
+        return GL_RGB;
+    }
+}
+
+size_t getBlockSize(BlockFormat format)
+{
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+BlockFormat chooseBlockFormat(const uint8_t* pixels, int width, int height, int components, bool isNormalMap)
+{
+    if (isNormalMap) return BLOCK_BC5;
+    if (components == 4) {
+        size_t count = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < count; i++) {
+            if (pixels[i * 4 + 3] != 255) return BLOCK_BC3;
+        }
+    }
+    return BLOCK_BC1;
+}
+
+void compressTexture(const uint8_t* pixels, int width, int height, int components, BlockFormat format, CompressedTexture& compressed)
+{
+    compressed = CompressedTexture();
+    compressed.format = format;
+    compressed.width = width;
+    compressed.height = height;
+
+    // Work in RGBA so every format reads its channels the same way
+    std::vector<uint8_t> level(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+        for (int c = 0; c < 4; c++) {
+            level[i * 4 + c] = c < components ? pixels[i * components + c] : 255;
+        }
+    }
+
+    size_t totalSize = 0;
+    for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+        totalSize += getLevelSize(format, w, h);
+        if (w == 1 && h == 1) break;
+    }
+    compressed.data.resize(totalSize);
+
+    int levelWidth = width;
+    int levelHeight = height;
+    std::vector<uint8_t> next;
+    size_t offset = 0;
+    while (true) {
+        size_t size = getLevelSize(format, levelWidth, levelHeight);
+        encodeLevel(level, levelWidth, levelHeight, format, compressed.data.data() + offset);
+        compressed.levelOffsets.push_back(offset);
+        compressed.levelSizes.push_back(size);
+        offset += size;
+        if (levelWidth == 1 && levelHeight == 1) break;
+
+        int nextWidth;
+        int nextHeight;
+        downsample(level, levelWidth, levelHeight, next, nextWidth, nextHeight);
+        level.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+}
+
+void decompressLevel(const CompressedTexture& compressed, int level, std::vector<uint8_t>& rgba)
+{
+    int width = std::max(compressed.width >> level, 1);
+    int height = std::max(compressed.height >> level, 1);
+    rgba.assign(static_cast<size_t>(width) * height * 4, 255);
+    if (compressed.format == BLOCK_BC5) {
+        // Z is not stored, leave blue at zero like the GPU does
+        for (size_t i = 2; i < rgba.size(); i += 4) rgba[i] = 0;
+    }
+
+    const uint8_t* in = compressed.data.data() + compressed.levelOffsets[level];
+    size_t blockSize = getBlockSize(compressed.format);
+    uint8_t block[64];
+    for (int blockY = 0; blockY < (height + 3) / 4; blockY++) {
+        for (int blockX = 0; blockX < (width + 3) / 4; blockX++) {
+            memset(block, 255, sizeof(block));
+            switch (compressed.format)
+            {
+            case BLOCK_BC1:
+                decodeColorBlock(in, block);
+                break;
+            case BLOCK_BC3:
+                decodeChannelBlock(in, 3, block);
+                decodeColorBlock(in + 8, block);
+                break;
+            case BLOCK_BC5:
+                decodeChannelBlock(in, 0, block);
+                decodeChannelBlock(in + 8, 1, block);
+                break;
+            }
+            for (int y = 0; y < 4 && blockY * 4 + y < height; y++) {
+                for (int x = 0; x < 4 && blockX * 4 + x < width; x++) {
+                    uint8_t* pixel = &rgba[(static_cast<size_t>(blockY * 4 + y) * width + blockX * 4 + x) * 4];
+                    int channels = compressed.format == BLOCK_BC5 ? 2 : 4;
+                    memcpy(pixel, block + (y * 4 + x) * 4, channels);
+                }
+            }
+            in += blockSize;
+        }
+    }
+}
+
+bool writeKtx(const std::string& path, const CompressedTexture& compressed, uint64_t sourceSize, int64_t sourceModifiedTime)
+{
+    KtxHeader header = {};
+    header.endianness = KTX_ENDIANNESS;
+    header.glTypeSize = 1;
+    header.glInternalFormat = compressed.getInternalFormat();
+    header.glBaseInternalFormat = compressed.getBaseFormat();
+    header.pixelWidth = static_cast<uint32_t>(compressed.width);
+    header.pixelHeight = static_cast<uint32_t>(compressed.height);
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = static_cast<uint32_t>(compressed.getLevelCount());
+
+    uint32_t keyValueSize = sizeof(KTX_STAMP_KEY) + sizeof(sourceSize) + sizeof(sourceModifiedTime);
+    uint32_t keyValuePadding = 3 - ((keyValueSize + 3) % 4);
+    header.bytesOfKeyValueData = sizeof(keyValueSize) + keyValueSize + keyValuePadding;
+
+    // Written aside and renamed, loader threads may cook the same image at once
+    std::string tempPath = path + ".tmp" + std::to_string(tempFileCounter.fetch_add(1));
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        const uint32_t padding = 0;
+        file.write(reinterpret_cast<const char*>(KTX_IDENTIFIER), sizeof(KTX_IDENTIFIER));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(&keyValueSize), sizeof(keyValueSize));
+        file.write(KTX_STAMP_KEY, sizeof(KTX_STAMP_KEY));
+        file.write(reinterpret_cast<const char*>(&sourceSize), sizeof(sourceSize));
+        file.write(reinterpret_cast<const char*>(&sourceModifiedTime), sizeof(sourceModifiedTime));
+        file.write(reinterpret_cast<const char*>(&padding), keyValuePadding);
+        for (int level = 0; level < compressed.getLevelCount(); level++) {
+            uint32_t imageSize = static_cast<uint32_t>(compressed.levelSizes[level]);
+            file.write(reinterpret_cast<const char*>(&imageSize), sizeof(imageSize));
+            file.write(reinterpret_cast<const char*>(compressed.data.data() + compressed.levelOffsets[level]), imageSize);
+        }
+        if (!file) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readKtx(const std::string& path, CompressedTexture& compressed, uint64_t& sourceSize, int64_t& sourceModifiedTime,
+    int firstLevel, int endLevel)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    uint8_t identifier[sizeof(KTX_IDENTIFIER)];
+    KtxHeader header;
+    file.read(reinterpret_cast<char*>(identifier), sizeof(identifier));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0 || header.endianness != KTX_ENDIANNESS
+        || header.glType != 0 || header.pixelDepth != 0 || header.numberOfArrayElements != 0 || header.numberOfFaces != 1
+        || header.pixelWidth == 0 || header.pixelHeight == 0 || header.numberOfMipmapLevels == 0 || header.numberOfMipmapLevels > 32) {
+        return false;
+    }
+
+    compressed = CompressedTexture();
+    switch (header.glInternalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        compressed.format = BLOCK_BC1;
+        break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        compressed.format = BLOCK_BC3;
+        break;
+    case GL_COMPRESSED_RG_RGTC2:
+        compressed.format = BLOCK_BC5;
+        break;
+    default:
+        return false;  // Not written by compressTexture
+    }
+    compressed.width = static_cast<int>(header.pixelWidth);
+    compressed.height = static_cast<int>(header.pixelHeight);
+
+    // Key/value pairs, only the source stamp is of interest
+    bool hasStamp = false;
+    std::vector<char> keyValues(header.bytesOfKeyValueData);
+    file.read(keyValues.data(), keyValues.size());
+    for (size_t offset = 0; file && offset + 4 <= keyValues.size();) {
+        uint32_t size;
+        memcpy(&size, &keyValues[offset], 4);
+        offset += 4;
+        if (size > keyValues.size() - offset) break;
+        if (size == sizeof(KTX_STAMP_KEY) + sizeof(sourceSize) + sizeof(sourceModifiedTime)
+            && memcmp(&keyValues[offset], KTX_STAMP_KEY, sizeof(KTX_STAMP_KEY)) == 0) {
+            memcpy(&sourceSize, &keyValues[offset + sizeof(KTX_STAMP_KEY)], sizeof(sourceSize));
+            memcpy(&sourceModifiedTime, &keyValues[offset + sizeof(KTX_STAMP_KEY) + sizeof(sourceSize)], sizeof(sourceModifiedTime));
+            hasStamp = true;
+        }
+        offset += size + 3 - ((size + 3) % 4);
+    }
+    if (!hasStamp) return false;
+
+    int width = compressed.width;
+    int height = compressed.height;
+    for (uint32_t level = 0; level < header.numberOfMipmapLevels; level++) {
+        uint32_t imageSize = 0;
+        file.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize));
+        if (!file || imageSize != getLevelSize(compressed.format, width, height)) return false;
+
+        size_t offset = compressed.data.size();
+        if (static_cast<int>(level) >= firstLevel && static_cast<int>(level) < endLevel) {
+            compressed.data.resize(offset + imageSize);
+            file.read(reinterpret_cast<char*>(compressed.data.data() + offset), imageSize);
+        }
+        else {
+            file.seekg(imageSize, std::ios::cur);
+        }
+        if (!file) return false;
+        compressed.levelOffsets.push_back(offset);
+        compressed.levelSizes.push_back(imageSize);
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Internal formats, not every glad loader is generated with the S3TC extension
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+
+enum BlockFormat
+{
+    BLOCK_BC1,  // Opaque color, 4 bits per pixel
+    BLOCK_BC3,  // Color with alpha, 8 bits per pixel
+    BLOCK_BC5   // Two channels, for normal maps: X and Y are kept, Z is rebuilt in the shader
+};
+
+// A block-compressed texture with its whole mip chain, level 0 first
+struct CompressedTexture
+{
+    BlockFormat format = BLOCK_BC1;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> data;         // Every level back to back
+    std::vector<size_t> levelOffsets;  // Into data
+    std::vector<size_t> levelSizes;
+
+    bool isValid() const {
+        return !levelSizes.empty();
+    }
+
+    int getLevelCount() const {
+        return static_cast<int>(levelSizes.size());
+    }
+
+    unsigned int getInternalFormat() const;
+    unsigned int getBaseFormat() const;
+};
+
+size_t getBlockSize(BlockFormat format);
+
+// Format for an image: BC5 for normal maps, BC3 when any pixel is translucent, BC1 otherwise
+BlockFormat chooseBlockFormat(const uint8_t* pixels, int width, int height, int components, bool isNormalMap);
+
+// Box-filters the full mip chain and encodes every level. Takes 3 or 4 component images.
+void compressTexture(const uint8_t* pixels, int width, int height, int components, BlockFormat format, CompressedTexture& compressed);
+
+// RGBA8 pixels of one level, for drivers without the format and for measuring the encoding error
+void decompressLevel(const CompressedTexture& compressed, int level, std::vector<uint8_t>& rgba);
+
+const int ALL_KTX_LEVELS = 32;
+
+// KTX 1.1 files. The size and modification time of the source image are kept as key/value data so a stale cooked
+// texture is recognized. readKtx can read only the levels [firstLevel, endLevel): the others are seeked past and keep
+// their size in levelSizes but have no bytes in data, so only the levels read may be uploaded.
+bool writeKtx(const std::string& path, const CompressedTexture& compressed, uint64_t sourceSize, int64_t sourceModifiedTime);
+bool readKtx(const std::string& path, CompressedTexture& compressed, uint64_t& sourceSize, int64_t& sourceModifiedTime,
+    int firstLevel = 0, int endLevel = ALL_KTX_LEVELS);
@@ -0,0 +1,282 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glad/glad.h>
+#include "TextureUtility.h"
+
+TextureStreamer::TextureStreamer(int threadCount, size_t budgetBytes) : jobs(std::max(threadCount, 1)), budgetBytes(budgetBytes)
+{
+
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    jobs.wait(group);
+}
+
+void TextureStreamer::setEnabled(bool enabled)
+{
+    this->enabled = enabled;
+}
+
+bool TextureStreamer::isEnabled() const
+{
+    return enabled;
+}
+
+void TextureStreamer::setBudget(size_t bytes)
+{
+    budgetBytes = bytes;
+}
+
+bool TextureStreamer::beginStreaming(unsigned int id, const std::string& cookedPath, const CompressedTexture& compressed)
+{
+    if (!enabled) return false;
+
+    int levelCount = compressed.getLevelCount();
+    int baseLevel = 0;
+    while (baseLevel < levelCount - 1 && std::max(compressed.width >> baseLevel, compressed.height >> baseLevel) > STREAMING_RESIDENT_SIZE) {
+        baseLevel++;
+    }
+    if (baseLevel == 0) return false;  // Small enough to stay resident
+
+    StreamedTexture texture;
+    texture.cookedPath = cookedPath;
+    texture.format = compressed.format;
+    texture.width = compressed.width;
+    texture.height = compressed.height;
+    texture.levelSizes = compressed.levelSizes;
+    texture.baseLevel = baseLevel;
+    texture.residentLevel = baseLevel;
+    texture.wantedLevel = baseLevel;
+    texture.serial = ++nextSerial;
+
+    for (int level = baseLevel; level < levelCount; level++) {
+        uploadCompressedLevel(compressed, level);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    residentBytes += getLevelBytes(texture, baseLevel, levelCount);
+    textures[id] = texture;
+    return true;
+}
+
+void TextureStreamer::stopStreaming(unsigned int id)
+{
+    auto it = textures.find(id);
+    if (it == textures.end()) return;
+
+    // A read still in flight no longer finds its serial and is dropped
+    const StreamedTexture& texture = it->second;
+    residentBytes -= getLevelBytes(texture, texture.residentLevel, static_cast<int>(texture.levelSizes.size()));
+    textures.erase(it);
+}
+
+void TextureStreamer::requestDetail(unsigned int id, float screenPixels)
+{
+    auto it = textures.find(id);
+    if (it == textures.end()) return;
+
+    // One texel per pixel across the surface
+    StreamedTexture& texture = it->second;
+    float texels = static_cast<float>(std::max(texture.width, texture.height));
+    int level = texture.baseLevel;
+    if (screenPixels > 0.0f) {
+        level = static_cast<int>(std::floor(std::log2(texels / screenPixels)));
+        level = std::min(std::max(level, 0), texture.baseLevel);
+    }
+
+    if (texture.lastUsedFrame != frame) {
+        texture.lastUsedFrame = frame;
+        texture.wantedLevel = level;
+    }
+    else {
+        texture.wantedLevel = std::min(texture.wantedLevel, level);
+    }
+}
+
+void TextureStreamer::update()
+{
+    uploadFinishedReads();
+    evictToFit(0, 0);  // The budget may have shrunk
+    startReads();
+    frame++;
+}
+
+void TextureStreamer::finishAll()
+{
+    while (startReads() > 0 || !reads.empty()) {
+        jobs.wait(group);
+        uploadFinishedReads();
+    }
+}
+
+void TextureStreamer::readLevels(void* data, int begin, int end)
+{
+    LevelRead* read = static_cast<LevelRead*>(data);
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    read->succeeded = readKtx(read->cookedPath, read->compressed, sourceSize, sourceModifiedTime, read->firstLevel, read->endLevel);
+    read->done.store(true, std::memory_order_release);
+}
+
+void TextureStreamer::uploadFinishedReads()
+{
+    for (size_t i = 0; i < reads.size();) {
+        LevelRead& read = *reads[i];
+        if (!read.done.load(std::memory_order_acquire)) {
+            i++;
+            continue;
+        }
+
+        auto it = textures.find(read.id);
+        if (it != textures.end() && it->second.serial == read.serial) {
+            StreamedTexture& texture = it->second;
+            texture.reading = false;
+            const CompressedTexture& compressed = read.compressed;
+            bool matches = read.succeeded && compressed.format == texture.format && compressed.width == texture.width
+                && compressed.height == texture.height && compressed.levelSizes == texture.levelSizes;
+            if (!matches) {
+                // Keep the levels already resident and stop asking for finer ones
+                std::cout << "WARNING::TEXTURE_STREAMER:: Could not read the levels of " << read.cookedPath << "." << std::endl;
+                texture.baseLevel = texture.residentLevel;
+            }
+            // Levels evicted while reading were not read, the next update asks for them again
+            else if (read.firstLevel < texture.residentLevel && read.endLevel == texture.residentLevel
+                && evictToFit(getLevelBytes(texture, read.firstLevel, texture.residentLevel), read.id)) {
+                glBindTexture(GL_TEXTURE_2D, read.id);
+                for (int level = texture.residentLevel - 1; level >= read.firstLevel; level--) {
+                    uploadCompressedLevel(compressed, level);
+                }
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, read.firstLevel);
+                residentBytes += getLevelBytes(texture, read.firstLevel, texture.residentLevel);
+                streamedInLevels += texture.residentLevel - read.firstLevel;
+                texture.residentLevel = read.firstLevel;
+            }
+        }
+        reads.erase(reads.begin() + i);
+    }
+}
+
+int TextureStreamer::startReads()
+{
+    // Bytes the budget could hold for new levels once every level nobody needs this frame is evicted
+    size_t evictable = 0;
+    for (const auto& pair : textures) {
+        if (!isProtected(pair.second)) {
+            evictable += getLevelBytes(pair.second, pair.second.residentLevel, pair.second.baseLevel);
+        }
+    }
+    size_t kept = residentBytes - evictable;
+    size_t available = budgetBytes > kept ? budgetBytes - kept : 0;
+
+    int started = 0;
+    for (auto& pair : textures) {
+        if (static_cast<int>(reads.size()) >= MAX_PENDING_TEXTURE_READS) break;
+        StreamedTexture& texture = pair.second;
+        if (texture.reading || texture.lastUsedFrame != frame || texture.wantedLevel >= texture.residentLevel) continue;
+
+        // As fine as wanted or as the budget allows
+        int level = texture.wantedLevel;
+        while (level < texture.residentLevel && getLevelBytes(texture, level, texture.residentLevel) > available) {
+            level++;
+        }
+        if (level == texture.residentLevel) continue;
+        available -= getLevelBytes(texture, level, texture.residentLevel);
+
+        std::unique_ptr<LevelRead> read(new LevelRead());
+        read->id = pair.first;
+        read->serial = texture.serial;
+        read->firstLevel = level;
+        read->endLevel = texture.residentLevel;
+        read->cookedPath = texture.cookedPath;
+        texture.reading = true;
+
+        Job job;
+        job.function = &TextureStreamer::readLevels;
+        job.data = read.get();
+        reads.push_back(std::move(read));
+        jobs.submit(group, job);
+        started++;
+    }
+    return started;
+}
+
+bool TextureStreamer::isProtected(const StreamedTexture& texture) const
+{
+    // Drawn this frame and its finest level is needed
+    return texture.lastUsedFrame == frame && texture.wantedLevel <= texture.residentLevel;
+}
+
+bool TextureStreamer::evictToFit(size_t bytes, unsigned int keepId)
+{
+    while (residentBytes + bytes > budgetBytes) {
+        // Least recently used texture that has fine levels to give
+        StreamedTexture* victim = nullptr;
+        unsigned int victimId = 0;
+        for (auto& pair : textures) {
+            StreamedTexture& texture = pair.second;
+            if (pair.first == keepId || texture.residentLevel >= texture.baseLevel || isProtected(texture)) continue;
+            if (!victim || texture.lastUsedFrame < victim->lastUsedFrame
+                || (texture.lastUsedFrame == victim->lastUsedFrame && texture.residentLevel < victim->residentLevel)) {
+                victim = &texture;
+                victimId = pair.first;
+            }
+        }
+        if (!victim) return false;
+        evictLevel(victimId, *victim);
+    }
+    return true;
+}
+
+void TextureStreamer::evictLevel(unsigned int id, StreamedTexture& texture)
+{
+    int level = texture.residentLevel++;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.residentLevel);
+
+    // Redefining the level as empty lets the driver free its storage
+    if (isBlockFormatSupported(texture.format)) {
+        CompressedTexture format;
+        format.format = texture.format;
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, format.getInternalFormat(), 0, 0, 0, 0, nullptr);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    residentBytes -= texture.levelSizes[level];
+    evictedLevels++;
+}
+
+size_t TextureStreamer::getLevelBytes(const StreamedTexture& texture, int firstLevel, int endLevel) const
+{
+    size_t bytes = 0;
+    for (int level = firstLevel; level < endLevel; level++) {
+        bytes += texture.levelSizes[level];
+    }
+    return bytes;
+}
+
+TextureStreamingStats TextureStreamer::getStats() const
+{
+    TextureStreamingStats stats;
+    stats.streamedTextures = static_cast<int>(textures.size());
+    stats.residentBytes = residentBytes;
+    stats.budgetBytes = budgetBytes;
+    stats.pendingRequests = static_cast<int>(reads.size());
+    stats.streamedInLevels = streamedInLevels;
+    stats.evictedLevels = evictedLevels;
+    return stats;
+}
+
+void TextureStreamer::printReport() const
+{
+    TextureStreamingStats stats = getStats();
+    std::cout << "TEXTURE_STREAMER:: " << stats.streamedTextures << " textures, resident: " << stats.residentBytes << " of "
+        << stats.budgetBytes << " bytes, pending requests: " << stats.pendingRequests << ", levels streamed in: "
+        << stats.streamedInLevels << ", evicted: " << stats.evictedLevels << std::endl;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.h"
+#include "TextureCompressor.h"
+
+const int DEFAULT_STREAMING_THREADS = 1;
+const size_t DEFAULT_TEXTURE_BUDGET_BYTES = 256 * 1024 * 1024;
+const int STREAMING_RESIDENT_SIZE = 64;  // Levels this size and smaller are uploaded at load and never evicted
+const int MAX_PENDING_TEXTURE_READS = 8;
+
+struct TextureStreamingStats
+{
+    int streamedTextures = 0;
+    size_t residentBytes = 0;   // Every level of the streamed textures on the GPU, counted as blocks
+    size_t budgetBytes = 0;
+    int pendingRequests = 0;    // Reads of finer levels in flight
+    int streamedInLevels = 0;   // Since the streamer was created
+    int evictedLevels = 0;
+};
+
+// Streams the fine mip levels of cooked textures.
+// At load a texture only gets its levels of STREAMING_RESIDENT_SIZE texels and smaller. Each frame the renderer asks
+// for the detail each visible texture needs from the size it covers on screen; finer levels are read from the KTX file
+// on a streaming thread and uploaded by update(). Resident levels stay within a global byte budget: the finest levels
+// of the least recently used textures are evicted first. Everything but the file reads runs on the GL thread.
+class TextureStreamer
+{
+public:
+    explicit TextureStreamer(int threadCount = DEFAULT_STREAMING_THREADS, size_t budgetBytes = DEFAULT_TEXTURE_BUDGET_BYTES);
+    // Waits for the reads in flight
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // On by default. Off, cooked textures loaded from then on get their whole mip chain.
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    // Takes effect at the next update, evicting until the resident levels fit
+    void setBudget(size_t bytes);
+
+    // Called by uploadTextureImage with the texture bound: uploads the coarse levels and keeps track of the rest.
+    // False when the texture is not streamed, small ones and everything while disabled, and gets every level.
+    bool beginStreaming(unsigned int id, const std::string& cookedPath, const CompressedTexture& compressed);
+    // Called before the texture is deleted
+    void stopStreaming(unsigned int id);
+
+    // Asks for enough detail on the texture for a surface covering screenPixels pixels across this frame.
+    // Textures that are not streamed are ignored.
+    void requestDetail(unsigned int id, float screenPixels);
+
+    // GL thread, once per frame after the requests: uploads finished reads, evicts to stay in budget and starts the
+    // reads this frame's requests need
+    void update();
+    // Reads and uploads everything requested this frame, for loading screens and tests
+    void finishAll();
+
+    TextureStreamingStats getStats() const;
+    void printReport() const;
+
+private:
+    struct StreamedTexture
+    {
+        std::string cookedPath;
+        BlockFormat format = BLOCK_BC1;
+        int width = 0;
+        int height = 0;
+        std::vector<size_t> levelSizes;
+        int baseLevel = 0;      // Coarsest streamed level plus one, from here on everything stays resident
+        int residentLevel = 0;  // Finest level on the GPU
+        int wantedLevel = 0;    // Finest level asked for in lastUsedFrame
+        uint64_t lastUsedFrame = 0;
+        unsigned int serial = 0;  // Tells reads apart from a texture that reused the id
+        bool reading = false;
+    };
+
+    // One read of a texture's KTX file on a streaming thread
+    struct LevelRead
+    {
+        unsigned int id = 0;
+        unsigned int serial = 0;
+        int firstLevel = 0;  // Finest level to upload
+        int endLevel = 0;    // Resident level when the read started, only [firstLevel, endLevel) is read
+        std::string cookedPath;
+        CompressedTexture compressed;
+        bool succeeded = false;
+        std::atomic<bool> done{ false };
+    };
+
+    JobSystem jobs;
+    JobGroup group;
+    bool enabled = true;
+    size_t budgetBytes;
+    size_t residentBytes = 0;
+    uint64_t frame = 1;
+    unsigned int nextSerial = 0;
+    int streamedInLevels = 0;
+    int evictedLevels = 0;
+    std::unordered_map<unsigned int, StreamedTexture> textures;  // By GL texture id
+    std::vector<std::unique_ptr<LevelRead>> reads;
+
+    static void readLevels(void* data, int begin, int end);
+    void uploadFinishedReads();
+    int startReads();  // Returns how many reads were started
+    bool isProtected(const StreamedTexture& texture) const;
+    bool evictToFit(size_t bytes, unsigned int keepId);
+    void evictLevel(unsigned int id, StreamedTexture& texture);
+    size_t getLevelBytes(const StreamedTexture& texture, int firstLevel, int endLevel) const;
+};
+
+// Streamer shared by every texture
+inline TextureStreamer& sharedTextureStreamer()
+{
+    static TextureStreamer streamer;
+    return streamer;
+}
@@ -1,14 +1,28 @@
 #include "TextureUtility.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <vector>
 #include <glad/glad.h>
+#include "MappedFile.h"
+#include "TextureStreamer.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 // Base directory for textures
 const std::string baseDirectory = "C:\\Users\\rituj\\Downloads\\Textures";
 
+static std::atomic<bool> textureCooking{ true };
+
 // Function to load a texture from file
 unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma) {
+    TextureImage image;
+    decodeTextureFile(path, directory, image);
+    return uploadTextureImage(image);
+}
+
+std::string resolveTexturePath(const char* path, const std::string& directory) {
     std::string filename = std::string(path);
 
     // Find the last slash in the filepath
@@ -17,45 +31,221 @@ unsigned int TextureFromFile(const char* path, const std::string& directory, boo
         filename = filename.substr(lastSlash + 1);  // Extract after the last slash
 
     // Construct the full path using the base directory
-    filename = baseDirectory + '\\' + filename;
+    return baseDirectory + '\\' + filename;
+}
 
-    std::cout << filename << std::endl;
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+bool decodeTextureFile(const char* path, const std::string& directory, TextureImage& image, TextureUsage usage) {
+    return decodeTextureImage(resolveTexturePath(path, directory), image, usage);
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+TextureUsage getTextureUsage(const std::string& typeName) {
+    return typeName == "texture_normal" ? TEXTURE_NORMAL : TEXTURE_COLOR;
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void setTextureCooking(bool enabled) {
+    textureCooking.store(enabled);
+}
+
+bool isTextureCookingEnabled() {
+    return textureCooking.load();
+}
+
+// FNV-1a over 8-byte words, fast enough to run on every decoded image.
+// Cooked images hash their blocks, which follow from the pixels, so cooked and freshly compressed copies match.
+static uint64_t hashPixels(const TextureImage& image) {
+    const uint64_t prime = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull;
+    hash = (hash ^ static_cast<uint64_t>(image.width)) * prime;
+    hash = (hash ^ static_cast<uint64_t>(image.height)) * prime;
+    hash = (hash ^ static_cast<uint64_t>(image.components)) * prime;
 
-        stbi_image_free(data);
+    const unsigned char* data = image.pixels;
+    size_t size = static_cast<size_t>(image.width) * image.height * image.components;
+    if (image.compressed.isValid()) {
+        hash = (hash ^ static_cast<uint64_t>(image.compressed.format)) * prime;
+        data = image.compressed.data.data();
+        size = image.compressed.data.size();
+    }
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+// Channels the GL texture of a cooked image has
+static int getComponentCount(BlockFormat format) {
+    switch (format)
+    {
+    case BLOCK_BC3:
+        return 4;
+    case BLOCK_BC5:
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+// The cooked file is used when it was written from the current image, or when the image itself is not shipped
+static bool readCookedTexture(const std::string& filename, TextureImage& image, TextureUsage usage) {
+    uint64_t cookedSize = 0;
+    int64_t cookedTime = 0;
+    if (!readKtx(filename + COOKED_TEXTURE_EXTENSION, image.compressed, cookedSize, cookedTime)) {
+        image.compressed = CompressedTexture();
+        return false;
+    }
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    bool hasSource = getFileStamp(filename, sourceSize, sourceTime);
+    bool isNormalMap = image.compressed.format == BLOCK_BC5;
+    if ((hasSource && (sourceSize != cookedSize || sourceTime != cookedTime)) || isNormalMap != (usage == TEXTURE_NORMAL)) {
+        image.compressed = CompressedTexture();
+        return false;
+    }
+
+    image.width = image.compressed.width;
+    image.height = image.compressed.height;
+    image.components = getComponentCount(image.compressed.format);
+    image.cookedPath = filename + COOKED_TEXTURE_EXTENSION;
+    return true;
+}
+
+// Replaces the decoded pixels by their compressed mip chain and writes it next to the image
+static void cookTexture(const std::string& filename, TextureImage& image, TextureUsage usage) {
+    BlockFormat format = chooseBlockFormat(image.pixels, image.width, image.height, image.components, usage == TEXTURE_NORMAL);
+    compressTexture(image.pixels, image.width, image.height, image.components, format, image.compressed);
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.components = getComponentCount(format);
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    std::string cookedPath = filename + COOKED_TEXTURE_EXTENSION;
+    if (getFileStamp(filename, sourceSize, sourceTime) && writeKtx(cookedPath, image.compressed, sourceSize, sourceTime)) {
+        image.cookedPath = cookedPath;
     }
     else {
+        std::cout << "WARNING::TEXTURE:: Could not write " << cookedPath << "." << std::endl;
+    }
+}
+
+bool decodeTextureImage(const std::string& filename, TextureImage& image, TextureUsage usage) {
+    bool cooking = isTextureCookingEnabled();
+    if (cooking && readCookedTexture(filename, image, usage)) {
+        image.contentHash = hashPixels(image);
+        return true;
+    }
+
+    image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    if (!image.pixels) {
         std::cerr << "Texture failed to load at path: " << filename << std::endl;
-        // Optionally, load a default texture if the desired one fails to load
-        stbi_image_free(data);  // Ensure no memory leak from previous stbi_load call
+        return false;
+    }
+    // One and two channel images stay uncompressed
+    if (cooking && image.components >= 3) {
+        cookTexture(filename, image, usage);
+    }
+    image.contentHash = hashPixels(image);
+    return true;
+}
+
+bool isBlockFormatSupported(BlockFormat format) {
+    if (format == BLOCK_BC5) {
+        return true;  // RGTC is core since OpenGL 3.0
+    }
+
+    static int s3tcSupported = -1;
+    if (s3tcSupported < 0) {
+        s3tcSupported = 0;
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; i++) {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0) {
+                s3tcSupported = 1;
+                break;
+            }
+        }
+        if (!s3tcSupported) {
+            std::cout << "WARNING::TEXTURE:: S3TC is not supported, cooked textures are decompressed on upload." << std::endl;
+        }
+    }
+    return s3tcSupported == 1;
+}
+
+void uploadCompressedLevel(const CompressedTexture& compressed, int level) {
+    int width = std::max(compressed.width >> level, 1);
+    int height = std::max(compressed.height >> level, 1);
+    if (isBlockFormatSupported(compressed.format)) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, compressed.getInternalFormat(), width, height, 0,
+            static_cast<GLsizei>(compressed.levelSizes[level]), compressed.data.data() + compressed.levelOffsets[level]);
+    }
+    else {
+        std::vector<uint8_t> rgba;
+        decompressLevel(compressed, level, rgba);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    }
+}
+
+// Uploads the precomputed mip chain, no glGenerateMipmap
+static void uploadCompressedLevels(const CompressedTexture& compressed) {
+    for (int level = 0; level < compressed.getLevelCount(); level++) {
+        uploadCompressedLevel(compressed, level);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, compressed.getLevelCount() - 1);
+}
+
+unsigned int uploadTextureImage(TextureImage& image) {
+    if (!image.hasData()) {
         // Load a default texture
         return loadDefaultTexture();
     }
 
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    GLenum format = GL_RGB;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (image.compressed.isValid()) {
+        // Streamed textures start with their coarse levels only
+        if (image.cookedPath.empty() || !sharedTextureStreamer().beginStreaming(textureID, image.cookedPath, image.compressed)) {
+            uploadCompressedLevels(image.compressed);
+        }
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    freeTextureImage(image);
     return textureID;
 }
 
+void freeTextureImage(TextureImage& image) {
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.compressed = CompressedTexture();
+    image.cookedPath.clear();
+}
+
 // Function to load a default texture
 unsigned int loadDefaultTexture(unsigned int width, unsigned int height) {
     unsigned int textureID;
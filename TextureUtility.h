@@ -1,7 +1,53 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include "TextureCompressor.h"
+
+// Pixels of a texture file decoded on the CPU, ready for uploadTextureImage
+struct TextureImage
+{
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned char* pixels = nullptr;  // Owned, freed by uploadTextureImage or freeTextureImage
+    CompressedTexture compressed;     // Cooked blocks and mip chain, uploaded instead of pixels when valid
+    std::string cookedPath;           // KTX file the blocks came from, finer levels stream in from it later
+    uint64_t contentHash = 0;         // Of the size and pixels, so identical images under different paths can be shared
+
+    bool hasData() const {
+        return pixels != nullptr || compressed.isValid();
+    }
+};
+
+// What a texture holds, colors and normal maps are cooked into different block formats
+enum TextureUsage
+{
+    TEXTURE_COLOR,
+    TEXTURE_NORMAL
+};
+
+const char* const COOKED_TEXTURE_EXTENSION = ".ktx";
 
 // Function declarations
 unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
+// Full path of the file a texture reference loads from
+std::string resolveTexturePath(const char* path, const std::string& directory);
+// Reads and decodes a texture file without touching OpenGL, so it can run on any thread. False if it failed to load.
+bool decodeTextureFile(const char* path, const std::string& directory, TextureImage& image, TextureUsage usage = TEXTURE_COLOR);
+// Loads the cooked file next to the image when it is up to date. Otherwise decodes the image and, with cooking
+// enabled, compresses it and writes the cooked file for the next run.
+bool decodeTextureImage(const std::string& filename, TextureImage& image, TextureUsage usage = TEXTURE_COLOR);
+TextureUsage getTextureUsage(const std::string& typeName);
+// On by default. Off, images are always decoded and uploaded uncompressed.
+void setTextureCooking(bool enabled);
+bool isTextureCookingEnabled();
+// Creates the GL texture and frees the pixels. Cooked images upload their blocks directly when the driver has the
+// format and are decompressed otherwise. Images that failed to decode get the default texture.
+unsigned int uploadTextureImage(TextureImage& image);
+// GL thread. Whether the driver samples the block format, asked once per format.
+bool isBlockFormatSupported(BlockFormat format);
+// One level into the bound texture, decompressed when the driver lacks the format
+void uploadCompressedLevel(const CompressedTexture& compressed, int level);
+void freeTextureImage(TextureImage& image);
 unsigned int loadDefaultTexture(unsigned int width = 1, unsigned int height = 1);
@@ -0,0 +1,215 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glad/glad.h>
+
+static bool vertexPacking = true;
+
+uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00);  // Too large, infinity
+    }
+    if (exponent <= 0) {
+        // Subnormal, or zero when even that is too small
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Rounded to nearest, a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) half++;
+    return static_cast<uint16_t>(half);
+}
+
+float unpackHalf(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+
+    float value;
+    if (exponent == 0) {
+        value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = exponent == 31 ? (sign | 0x7F800000 | (mantissa << 13)) : (sign | ((exponent + 112) << 23) | (mantissa << 13));
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+uint32_t packSnorm1010102(const glm::vec3& value, float w)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; i++) {
+        int component = static_cast<int>(std::round(std::min(std::max(value[i], -1.0f), 1.0f) * 511.0f));
+        packed |= (static_cast<uint32_t>(component) & 0x3FF) << (i * 10);
+    }
+    int sign = w < 0.0f ? -1 : 1;
+    packed |= (static_cast<uint32_t>(sign) & 0x3) << 30;
+    return packed;
+}
+
+glm::vec4 unpackSnorm1010102(uint32_t packed)
+{
+    glm::vec4 value;
+    for (int i = 0; i < 3; i++) {
+        int component = static_cast<int>((packed >> (i * 10)) & 0x3FF);
+        if (component & 0x200) component -= 0x400;
+        value[i] = std::max(component / 511.0f, -1.0f);
+    }
+    int w = static_cast<int>(packed >> 30);
+    value.w = static_cast<float>(w & 0x2 ? w - 4 : w);
+    return value;
+}
+
+void setVertexPacking(bool enabled)
+{
+    vertexPacking = enabled;
+}
+
+bool isVertexPackingEnabled()
+{
+    return vertexPacking;
+}
+
+VertexLayout chooseVertexLayout(const Vertex* vertices, size_t count)
+{
+    if (!vertexPacking) return VERTEX_FULL;
+
+    bool skinned = false;
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        if (std::fabs(vertex.TexCoords.x) > HALF_TEXCOORD_LIMIT || std::fabs(vertex.TexCoords.y) > HALF_TEXCOORD_LIMIT) {
+            return VERTEX_FULL;
+        }
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            if (vertex.Weights[j] == 0.0f) continue;
+            if (vertex.BoneIDs[j] < 0 || vertex.BoneIDs[j] > MAX_PACKED_BONE_ID) return VERTEX_FULL;
+            skinned = true;
+        }
+    }
+    return skinned ? VERTEX_PACKED_SKINNED : VERTEX_PACKED_STATIC;
+}
+
+size_t getVertexStride(VertexLayout layout)
+{
+    switch (layout)
+    {
+    case VERTEX_PACKED_SKINNED:
+        return sizeof(PackedSkinnedVertex);
+    case VERTEX_PACKED_STATIC:
+        return sizeof(PackedStaticVertex);
+    default:
+        return sizeof(Vertex);
+    }
+}
+
+// Unsigned normalized weights; when they sum to one the rounding error goes to the largest so they still do
+static void packWeights(const glm::vec4& weights, uint8_t packed[MAX_BONE_INFLUENCE])
+{
+    int sum = 0;
+    int largest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        int weight = static_cast<int>(std::round(std::min(std::max(weights[i], 0.0f), 1.0f) * 255.0f));
+        packed[i] = static_cast<uint8_t>(weight);
+        sum += weight;
+        if (weights[i] > weights[largest]) largest = i;
+    }
+    float sourceSum = weights[0] + weights[1] + weights[2] + weights[3];
+    if (std::fabs(sourceSum - 1.0f) < 0.001f) {
+        packed[largest] = static_cast<uint8_t>(std::min(std::max(packed[largest] + 255 - sum, 0), 255));
+    }
+}
+
+template <typename PackedType>
+static void packCommon(const Vertex& vertex, PackedType& packed)
+{
+    packed.Position = vertex.Position;
+    packed.Normal = packSnorm1010102(vertex.Normal, 1.0f);
+    float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+    packed.Tangent = packSnorm1010102(vertex.Tangent, handedness);
+    packed.TexCoords[0] = packHalf(vertex.TexCoords.x);
+    packed.TexCoords[1] = packHalf(vertex.TexCoords.y);
+}
+
+void packVertices(const Vertex* vertices, size_t count, VertexLayout layout, std::vector<uint8_t>& packed)
+{
+    packed.resize(count * getVertexStride(layout));
+    if (layout == VERTEX_FULL) {
+        memcpy(packed.data(), vertices, packed.size());
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        if (layout == VERTEX_PACKED_STATIC) {
+            PackedStaticVertex out;
+            packCommon(vertex, out);
+            memcpy(packed.data() + i * sizeof(out), &out, sizeof(out));
+            continue;
+        }
+
+        PackedSkinnedVertex out;
+        packCommon(vertex, out);
+        packWeights(vertex.Weights, out.Weights);
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            out.BoneIDs[j] = static_cast<uint8_t>(out.Weights[j] != 0 ? vertex.BoneIDs[j] : 0);
+        }
+        memcpy(packed.data() + i * sizeof(out), &out, sizeof(out));
+    }
+}
+
+void setVertexAttributes(VertexLayout layout, unsigned int locationMask)
+{
+    GLsizei stride = static_cast<GLsizei>(getVertexStride(layout));
+    auto enable = [locationMask](int location) {
+        if (!(locationMask & vertexAttributeBit(location))) return false;
+        glEnableVertexAttribArray(location);
+        return true;
+    };
+
+    if (layout == VERTEX_FULL) {
+        if (enable(0)) glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Position));
+        if (enable(1)) glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+        if (enable(2)) glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+        if (enable(3)) glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+        if (enable(4)) glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+        if (enable(5)) glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, BoneIDs));
+        if (enable(6)) glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Weights));
+        return;
+    }
+
+    // Both packed layouts share their first fields, the bitangent is rebuilt in the shader
+    if (enable(0)) glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedSkinnedVertex, Position));
+    if (enable(1)) glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedSkinnedVertex, Normal));
+    if (enable(2)) glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedSkinnedVertex, TexCoords));
+    if (enable(3)) glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedSkinnedVertex, Tangent));
+    if (locationMask & vertexAttributeBit(4)) glDisableVertexAttribArray(4);
+    if (layout == VERTEX_PACKED_SKINNED) {
+        if (enable(5)) glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(PackedSkinnedVertex, BoneIDs));
+        if (enable(6)) glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(PackedSkinnedVertex, Weights));
+    }
+    else {
+        if (locationMask & vertexAttributeBit(5)) glDisableVertexAttribArray(5);
+        if (locationMask & vertexAttributeBit(6)) glDisableVertexAttribArray(6);
+    }
+}
+
+void clearSkinAttributes()
+{
+    glVertexAttribI4i(5, 0, 0, 0, 0);
+    glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define MAX_BONE_INFLUENCE 4
+
+// Vertex as built on the CPU, kept for bounds, CPU skinning, collision and cooked models
+struct Vertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+    glm::ivec4 BoneIDs = glm::ivec4(0); // Initialize to zero
+    glm::vec4 Weights = glm::vec4(0.0f); // Initialize to zero
+};
+
+// How a mesh's vertices are laid out in its vertex buffer
+enum VertexLayout
+{
+    VERTEX_FULL,            // Vertex as is
+    VERTEX_PACKED_SKINNED,  // PackedSkinnedVertex
+    VERTEX_PACKED_STATIC    // PackedStaticVertex, no bone indices or weights
+};
+
+// Normal and tangent are signed 10:10:10:2 (GL_INT_2_10_10_10_REV), the tangent's w holding the sign of the bitangent
+// so the shader rebuilds it as cross(normal, tangent) * w. Texture coordinates are half floats.
+struct PackedStaticVertex {
+    glm::vec3 Position;
+    uint32_t Normal;
+    uint32_t Tangent;
+    uint16_t TexCoords[2];
+};
+
+struct PackedSkinnedVertex {
+    glm::vec3 Position;
+    uint32_t Normal;
+    uint32_t Tangent;
+    uint16_t TexCoords[2];
+    uint8_t BoneIDs[MAX_BONE_INFLUENCE];
+    uint8_t Weights[MAX_BONE_INFLUENCE];  // Unsigned normalized, summing to 255 when the source weights sum to one
+};
+
+static_assert(sizeof(PackedStaticVertex) == 24, "PackedStaticVertex is uploaded as is");
+static_assert(sizeof(PackedSkinnedVertex) == 32, "PackedSkinnedVertex is uploaded as is");
+
+const float HALF_TEXCOORD_LIMIT = 4.0f;  // Beyond this half floats step by more than 1/512 of a texture repeat
+const int MAX_PACKED_BONE_ID = 255;
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;  // Meshes up to this many vertices get 16-bit indices
+
+// Vertex attribute locations, the same in every vertex shader
+const unsigned int ALL_VERTEX_ATTRIBUTES = 0x7F;  // Locations 0 to 6
+inline unsigned int vertexAttributeBit(int location)
+{
+    return 1u << location;
+}
+
+uint16_t packHalf(float value);
+float unpackHalf(uint16_t half);
+uint32_t packSnorm1010102(const glm::vec3& value, float w);
+glm::vec4 unpackSnorm1010102(uint32_t packed);
+
+// On by default. Off, meshes created afterwards keep the full layout.
+void setVertexPacking(bool enabled);
+bool isVertexPackingEnabled();
+
+// Smallest layout that holds every vertex: skin streams only when a vertex has a weight, the full layout when a
+// bone index or texture coordinate does not fit the packed fields
+VertexLayout chooseVertexLayout(const Vertex* vertices, size_t count);
+size_t getVertexStride(VertexLayout layout);
+// Vertices in the layout's format, ready for glBufferData
+void packVertices(const Vertex* vertices, size_t count, VertexLayout layout, std::vector<uint8_t>& packed);
+
+// GL thread. Points the attributes in locationMask at the vertex buffer bound to GL_ARRAY_BUFFER.
+void setVertexAttributes(VertexLayout layout, unsigned int locationMask = ALL_VERTEX_ATTRIBUTES);
+// Static layouts have no skin streams, so the shaders read the current attribute values instead: no bones, zero weight.
+// Call after binding their vertex array.
+void clearSkinAttributes();
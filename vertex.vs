@@ -3,15 +3,22 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in vec3 aTangent;
-layout(location = 4) in vec3 aBitangent;
+layout(location = 3) in vec4 aTangent;   // w: bitangent sign, packed layouts encode the bitangent only through it
+layout(location = 4) in vec3 aBitangent; // Full vertex layout only. This shader reads neither tangent attribute.
 layout(location = 5) in ivec4 aBoneIDs;
 layout(location = 6) in vec4 aWeights;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
-uniform mat4 bones[100]; // Assuming you have a maximum of 100 bones
+
+#define MAX_BONES 100 // Same as MAX_BONES in BonePalette.h
+
+// Filled by BonePalette with one buffer update per draw
+layout(std140) uniform BonePalette
+{
+    mat4 bones[MAX_BONES];
+};
 
 out vec2 TexCoords;
 out vec3 Normal;